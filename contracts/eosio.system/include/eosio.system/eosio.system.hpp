@@ -10,8 +10,11 @@
 
 #include <eosio.system/exchange_state.hpp>
 #include <eosio.system/native.hpp>
+#include <eosio.system/onblock_metrics.hpp>
 
 #include <deque>
+#include <limits>
+#include <map>
 #include <optional>
 #include <string>
 #include <type_traits>
@@ -118,10 +121,44 @@ namespace eosiosystem {
 
    typedef eosio::multi_index< "payments"_n, payment_info > payments_table;
 
+   // Order independent digest of a set of producer names, used to compare schedules without sorting them
+   struct schedule_fingerprint {
+      uint32_t count = 0;
+      uint64_t hash  = 0;
+
+      void add( const name& producer ) {
+         // splitmix64 finalizer, summed so the order of the names does not matter
+         uint64_t z = producer.value + 0x9e3779b97f4a7c15ull;
+         z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+         z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+         hash += z ^ (z >> 31);
+         ++count;
+      }
+
+      friend bool operator == ( const schedule_fingerprint& a, const schedule_fingerprint& b ) {
+         return a.count == b.count && a.hash == b.hash;
+      }
+      friend bool operator != ( const schedule_fingerprint& a, const schedule_fingerprint& b ) {
+         return !(a == b);
+      }
+
+      EOSLIB_SERIALIZE( schedule_fingerprint, (count)(hash) )
+   };
+
+   // Remembers whether the active schedule last seen by onblock matched the proposed one in producers_metric
+   struct schedule_activation_cache {
+      schedule_fingerprint proposed;   // fingerprint of producers_metric
+      schedule_fingerprint active;     // fingerprint of the active schedule `activated` was computed for
+      bool                 activated = false;
+
+      EOSLIB_SERIALIZE( schedule_activation_cache, (proposed)(active)(activated) )
+   };
+
    struct [[eosio::table("schedulemetr"), eosio::contract("eosio.system")]] schedule_metrics_state {
      name                             last_onblock_caller;
      int32_t                          block_counter_correction;
      std::vector<producer_metric>     producers_metric;
+     binary_extension<schedule_activation_cache> activation_cache;
 
      uint64_t primary_key()const { return last_onblock_caller.value; }
    };
@@ -156,6 +193,116 @@ namespace eosiosystem {
 
    typedef eosio::singleton< "payrate"_n, payrates > payrate_singleton;
 
+   // Upper bounds on the rows a vote recalculation may touch in a single onblock
+   static constexpr uint32_t recalc_voters_per_block    = 20;
+   static constexpr uint32_t recalc_producers_per_block = 50;
+
+   enum class recalc_phase : uint8_t {
+      reset = 0, // seeding one tally row per registered producer
+      tally = 1, // accumulating voter weights into the tally rows
+      apply = 2  // copying tally rows into the producers table
+   };
+
+   // Progress of an in-flight vote recalculation; the singleton only exists while one is running
+   struct [[eosio::table("recalcvotes"), eosio::contract("eosio.system")]] vote_recalc_state {
+      uint8_t  phase = static_cast<uint8_t>(recalc_phase::reset);
+      name     cursor;                           // last producer seeded or last voter tallied
+      double   total_producer_vote_weight = 0;   // rebuilt totals, swapped into the global state when done
+      int64_t  total_activated_stake = 0;
+
+      bool is_tallied( const name& voter )const {
+         return phase == static_cast<uint8_t>(recalc_phase::apply) ||
+                ( phase == static_cast<uint8_t>(recalc_phase::tally) && voter.value <= cursor.value );
+      }
+
+      EOSLIB_SERIALIZE( vote_recalc_state, (phase)(cursor)(total_producer_vote_weight)(total_activated_stake) )
+   };
+
+   typedef eosio::singleton< "recalcvotes"_n, vote_recalc_state > vote_recalc_singleton;
+
+   // Rebuilt vote total of a producer, pending until the recalculation reaches its apply phase
+   struct [[eosio::table, eosio::contract("eosio.system")]] vote_tally {
+      name     owner;
+      double   total_votes = 0;
+
+      uint64_t primary_key()const { return owner.value; }
+
+      EOSLIB_SERIALIZE( vote_tally, (owner)(total_votes) )
+   };
+
+   typedef eosio::multi_index< "recalctally"_n, vote_tally > vote_tally_table;
+
+   enum class compact_votes_stage : uint8_t {
+      disabled  = 0, // votes are stored as names
+      producers = 1, // assigning ids to the producers registered before the prodids table existed
+      voters    = 2, // every producer has an id, new votes are stored as ids and existing voters are converted
+      done      = 3  // every voter has been converted
+   };
+
+   // Bookkeeping that lets update_elected_producers avoid walking the whole producers table. Seeded by init on new
+   // chains and by initelect on upgraded ones, until then it is only kept in memory.
+   struct [[eosio::table("electstate"), eosio::contract("eosio.system")]] election_state {
+      uint32_t                 active_producers = 0;     // registered producers with is_active set
+      uint64_t                 vote_epoch = 1;           // bumped by anything that can change the producer ranking
+      uint64_t                 last_elected_epoch = 0;   // vote_epoch the last ranking pass ran at
+      eosio::checksum256       last_schedule_digest;     // sha256 of the last schedule handed to set_proposed_producers
+      double                   last_elected_cutoff = 0;  // lowest total_votes the last pass ranked, 0 when it ranked all
+
+      EOSLIB_SERIALIZE( election_state, (active_producers)(vote_epoch)(last_elected_epoch)(last_schedule_digest)
+                                        (last_elected_cutoff) )
+   };
+
+   typedef eosio::singleton< "electstate"_n, election_state > election_state_singleton;
+
+   // Fixed point vote weights, enabled once by setfixedvote
+   struct [[eosio::table("fixedvote"), eosio::contract("eosio.system")]] fixed_vote_state {
+      bool     enabled = false; // vote weights are whole numbers computed with integer math
+
+      EOSLIB_SERIALIZE( fixed_vote_state, (enabled) )
+   };
+
+   typedef eosio::singleton< "fixedvote"_n, fixed_vote_state > fixed_vote_singleton;
+
+   // Progress of the migration of votes to producer ids, see migvoterids
+   struct [[eosio::table("compactvote"), eosio::contract("eosio.system")]] compact_votes_state {
+      uint8_t  stage = static_cast<uint8_t>(compact_votes_stage::disabled);
+      name     cursor;          // last producer or voter migrated
+
+      EOSLIB_SERIALIZE( compact_votes_state, (stage)(cursor) )
+   };
+
+   typedef eosio::singleton< "compactvote"_n, compact_votes_state > compact_votes_singleton;
+
+   // Position of voteupdbatch in the voters table
+   struct [[eosio::table("voteupdbat"), eosio::contract("eosio.system")]] vote_update_state {
+      name     cursor;          // last voter refreshed, empty to start over
+
+      EOSLIB_SERIALIZE( vote_update_state, (cursor) )
+   };
+
+   typedef eosio::singleton< "voteupdbat"_n, vote_update_state > vote_update_singleton;
+
+   // Vote journal setting, see setvotejrnl
+   struct [[eosio::table("votejrnlcfg"), eosio::contract("eosio.system")]] vote_journal_config {
+      bool     enabled = false; // producer vote changes are journaled and folded by onblock
+
+      EOSLIB_SERIALIZE( vote_journal_config, (enabled) )
+   };
+
+   typedef eosio::singleton< "votejrnlcfg"_n, vote_journal_config > vote_journal_config_singleton;
+
+   // Net change of a producer's total_votes since the last onblock, used when vote_journal_config::enabled is set
+   struct [[eosio::table, eosio::contract("eosio.system")]] vote_journal_entry {
+      name     producer;
+      double   delta = 0;
+
+      uint64_t primary_key()const { return producer.value; }
+
+      EOSLIB_SERIALIZE( vote_journal_entry, (producer)(delta) )
+   };
+
+   typedef eosio::multi_index< "votejournal"_n, vote_journal_entry > vote_journal_table;
+
 
    enum class kick_type {
       REACHED_TRESHOLD = 1,
@@ -208,6 +355,29 @@ namespace eosiosystem {
 
    typedef eosio::multi_index< "bidrefunds"_n, bid_refund > bid_refund_table;
 
+   // TELOS BEGIN
+   // Outbid amounts owed to a bidder across all names, paid by claimbidref or bidrefexec
+   struct [[eosio::table, eosio::contract("eosio.system")]] bid_refund_ledger {
+      name         bidder;
+      asset        amount;
+
+      uint64_t primary_key()const { return bidder.value; }
+   };
+
+   typedef eosio::multi_index< "bidledger"_n, bid_refund_ledger > bid_refund_ledger_table;
+
+   // Highest open bid of the `highbid` index, so that onblock can check for an auction to close without the bids table
+   struct [[eosio::table("topbid"), eosio::contract("eosio.system")]] top_bid {
+      name            newname;
+      int64_t         high_bid = 0; ///< 0 when there is no open auction
+      time_point      last_bid_time;
+
+      EOSLIB_SERIALIZE( top_bid, (newname)(high_bid)(last_bid_time) )
+   };
+
+   typedef eosio::singleton< "topbid"_n, top_bid > top_bid_singleton;
+   // TELOS END
+
    // Defines new global state parameters.
    struct [[eosio::table("global"), eosio::contract("eosio.system")]] eosio_global_state : eosio::blockchain_parameters {
       uint64_t free_ram()const { return max_ram_size - total_ram_bytes_reserved; }
@@ -413,6 +583,47 @@ namespace eosiosystem {
       }
    };
 
+   // TELOS BEGIN
+   // Registry of short producer ids, used by the compact vote format of `voter_info`
+   struct [[eosio::table("prodids"), eosio::contract("eosio.system")]] producer_id {
+      uint64_t        id;
+      name            owner;
+
+      uint64_t primary_key()const { return id; }
+      uint64_t by_owner()const    { return owner.value; }
+
+      EOSLIB_SERIALIZE( producer_id, (id)(owner) )
+   };
+
+   typedef eosio::multi_index< "prodids"_n, producer_id,
+                               indexed_by<"byowner"_n, const_mem_fun<producer_id, uint64_t, &producer_id::by_owner>>
+                             > producer_ids_table;
+
+   // Per-block counters of a producer, kept out of `producer_info` so that onblock rewrites a few fixed-size
+   // bytes instead of the whole producer row. When a producer has a row here, the counters of the same name
+   // in `producer_info` are no longer maintained.
+   struct [[eosio::table, eosio::contract("eosio.system")]] producer_stats {
+      name            owner;
+      uint32_t        unpaid_blocks = 0;
+      uint32_t        lifetime_produced_blocks = 0;
+
+      uint64_t primary_key()const { return owner.value; }
+
+      EOSLIB_SERIALIZE( producer_stats, (owner)(unpaid_blocks)(lifetime_produced_blocks) )
+   };
+
+   typedef eosio::multi_index< "prodstats"_n, producer_stats > producer_stats_table;
+
+   // Position of migprodstats in the producers table
+   struct [[eosio::table("prodstatmig"), eosio::contract("eosio.system")]] prodstats_migration_state {
+      name     cursor;          // last producer visited
+
+      EOSLIB_SERIALIZE( prodstats_migration_state, (cursor) )
+   };
+
+   typedef eosio::singleton< "prodstatmig"_n, prodstats_migration_state > prodstats_migration_singleton;
+   // TELOS END
+
    // Defines new producer info structure to be stored in new producer info table, added after version 1.3.0
    struct [[eosio::table, eosio::contract("eosio.system")]] producer_info2 {
       name            owner;
@@ -452,22 +663,84 @@ namespace eosiosystem {
 
       uint32_t            flags1 = 0;
       uint32_t            reserved2 = 0;
-      eosio::asset        reserved3;
+      eosio::asset        reserved3; /// TELOS: total stake delegated by this voter, valid when flags1 has delegated_tracked
+
+      // TELOS BEGIN
+      /// compact form of `producers`: ids from the `prodids` table, in the name order of the producers.
+      /// When present, `producers` is left empty, use system_contract::get_voter_producers to read the votes.
+      eosio::binary_extension<std::vector<uint16_t>>  producer_ids;
+      // TELOS END
 
       uint64_t primary_key()const { return owner.value; }
+      uint64_t by_proxy()const    { return proxy.value; } // TELOS
+
+      // TELOS
+      size_t   producer_count()const { return producer_ids.has_value() ? producer_ids->size() : producers.size(); }
 
       enum class flags1_fields : uint32_t {
          ram_managed = 1,
          net_managed = 2,
-         cpu_managed = 4
+         cpu_managed = 4,
+         delegated_tracked = 8 // TELOS: reserved3 holds the sum of the voter's del_bandwidth_table rows
       };
 
-      // explicit serialization macro is not necessary, used here only to improve compilation time
-      EOSLIB_SERIALIZE( voter_info, (owner)(proxy)(producers)(staked)(last_stake)(last_vote_weight)(proxied_vote_weight)(is_proxy)(flags1)(reserved2)(reserved3) )
+      // TELOS EDITED WITH CUSTOM SERIALIZATION
+      // Like producer_info, the producer_ids binary extension is only written when present, so that rows
+      // modified without switching to the compact form keep their size.
+      template<typename DataStream>
+      friend DataStream& operator << ( DataStream& ds, const voter_info& t ) {
+         ds << t.owner
+            << t.proxy
+            << t.producers
+            << t.staked
+            << t.last_stake
+            << t.last_vote_weight
+            << t.proxied_vote_weight
+            << t.is_proxy
+            << t.flags1
+            << t.reserved2
+            << t.reserved3;
+
+         if( !t.producer_ids.has_value() ) return ds;
+
+         return ds << t.producer_ids;
+      }
+
+      template<typename DataStream>
+      friend DataStream& operator >> ( DataStream& ds, voter_info& t ) {
+         return ds >> t.owner
+                   >> t.proxy
+                   >> t.producers
+                   >> t.staked
+                   >> t.last_stake
+                   >> t.last_vote_weight
+                   >> t.proxied_vote_weight
+                   >> t.is_proxy
+                   >> t.flags1
+                   >> t.reserved2
+                   >> t.reserved3
+                   >> t.producer_ids;
+      }
    };
 
 
-   typedef eosio::multi_index< "voters"_n, voter_info >  voters_table;
+   // TELOS EDITED: `byproxy` lists the voters delegating to a proxy. Rows written before the index existed are
+   // only indexed once the proxy index migration (migproxyidx) rewrites them.
+   typedef eosio::multi_index< "voters"_n, voter_info,
+                               indexed_by<"byproxy"_n, const_mem_fun<voter_info, uint64_t, &voter_info::by_proxy>  >
+                             > voters_table;
+
+   // TELOS BEGIN
+   // Progress of the migration adding the voters written before the `byproxy` index to it
+   struct [[eosio::table("proxyidx"), eosio::contract("eosio.system")]] proxy_index_state {
+      bool     done = false; // every voter using a proxy is in the byproxy index
+      name     cursor;       // last voter visited by migproxyidx
+
+      EOSLIB_SERIALIZE( proxy_index_state, (done)(cursor) )
+   };
+
+   typedef eosio::singleton< "proxyidx"_n, proxy_index_state > proxy_index_singleton;
+   // TELOS END
 
 
    typedef eosio::multi_index< "producers"_n, producer_info,
@@ -531,6 +804,32 @@ namespace eosiosystem {
    typedef eosio::multi_index< "delband"_n, delegated_bandwidth > del_bandwidth_table;
    typedef eosio::multi_index< "refunds"_n, refund_request >      refunds_table;
 
+   // TELOS BEGIN
+   // Refund queue settings: `exec_max` is the number of owners a single refundexec may pay
+   struct [[eosio::table("refundcfg"),eosio::contract("eosio.system")]] refund_config {
+      uint16_t    exec_max = 10;
+
+      EOSLIB_SERIALIZE( refund_config, (exec_max) )
+   };
+
+   typedef eosio::singleton< "refundcfg"_n, refund_config > refund_config_singleton;
+
+   // Pending refund of an account, ordered by the time it matures. Replaces the deferred refund transaction.
+   struct [[eosio::table, eosio::contract("eosio.system")]] refund_queue_entry {
+      name            owner;
+      time_point_sec  due;
+
+      uint64_t  primary_key()const { return owner.value; }
+      uint64_t  by_due()const      { return due.utc_seconds; }
+
+      EOSLIB_SERIALIZE( refund_queue_entry, (owner)(due) )
+   };
+
+   typedef eosio::multi_index< "refundqueue"_n, refund_queue_entry,
+                               indexed_by<"bydue"_n, const_mem_fun<refund_queue_entry, uint64_t, &refund_queue_entry::by_due>>
+                             > refund_queue_table;
+   // TELOS END
+
    // `rex_pool` structure underlying the rex pool table. A rex pool table entry is defined by:
    // - `version` defaulted to zero,
    // - `total_lent` total amount of CORE_SYMBOL in open rex_loans
@@ -555,6 +854,30 @@ namespace eosiosystem {
 
    typedef eosio::multi_index< "rexpool"_n, rex_pool > rex_pool_table;
 
+   // TELOS BEGIN
+   // REX processing settings: while `keeper_mode` is set, REX actions of users no longer process expired loans and
+   // sell orders, an off-chain keeper pushes rexexec for them instead
+   struct [[eosio::table("rexconfig"),eosio::contract("eosio.system")]] rex_config {
+      bool        keeper_mode = false;
+
+      EOSLIB_SERIALIZE( rex_config, (keeper_mode) )
+   };
+
+   typedef eosio::singleton< "rexconfig"_n, rex_config > rex_config_singleton;
+
+   // Work units charged by runrex, an abstract cost counting the table rows touched and inline actions sent:
+   // every due loan updates its row and the receiver resource limits, a renewed loan also updates the two return
+   // pool rows and a closed loan with a balance refunds its REX fund; every open sell order is read, a filled one
+   // also updates the owner REX balance, the order row and sends orderresult.
+   static constexpr uint32_t runrex_loan_work   = 2;
+   static constexpr uint32_t runrex_renew_work  = 2;
+   static constexpr uint32_t runrex_refund_work = 1;
+   static constexpr uint32_t runrex_order_work  = 1;
+   static constexpr uint32_t runrex_fill_work   = 3;
+   static constexpr uint32_t runrex_no_budget   = std::numeric_limits<uint32_t>::max();
+   static constexpr uint32_t runrex_backlog_max = 100; // entries counted per queue when reporting the backlog
+   // TELOS END
+
    // `rex_return_pool` structure underlying the rex return pool table. A rex return pool table entry is defined by:
    // - `version` defaulted to zero,
    // - `last_dist_time` the last time proceeds from renting, ram fees, and name bids were added to the rex pool,
@@ -590,12 +913,24 @@ namespace eosiosystem {
    };
 
    // `rex_return_buckets` structure underlying the rex return buckets table. A rex return buckets table is defined by:
-   // - `version` defaulted to zero,
+   // - `version` defaulted to zero, 1 for the ring layout (TELOS)
    // - `return_buckets` buckets of proceeds accumulated in 12-hour intervals
    struct [[eosio::table,eosio::contract("eosio.system")]] rex_return_buckets {
       uint8_t                                version = 0;
       std::vector<pair_time_point_sec_int64> return_buckets;  // sorted by first field
 
+      // TELOS BEGIN
+      // In the ring layout `return_buckets` always holds `ring_slots` entries, a bucket is stored in the slot given
+      // by its time and empty slots have a zero time, so adding or expiring a bucket never resizes the row.
+      static constexpr uint8_t  ring_version = 1;
+      static constexpr uint32_t bucket_interval = rex_return_pool::hours_per_bucket * seconds_per_hour;
+      static constexpr uint32_t ring_slots = rex_return_pool::total_intervals * rex_return_pool::dist_interval / bucket_interval;
+
+      static uint32_t ring_slot( const time_point_sec& bucket_time ) {
+         return ( bucket_time.sec_since_epoch() / bucket_interval ) % ring_slots;
+      }
+      // TELOS END
+
       uint64_t primary_key()const { return 0; }
    };
 
@@ -621,6 +956,7 @@ namespace eosiosystem {
    // - `vote_stake` the amount of CORE_SYMBOL currently included in owner's vote,
    // - `rex_balance` the amount of REX owned by owner,
    // - `matured_rex` matured REX available for selling
+   // - `rex_maturities` REX daily maturity buckets, in the ring layout (`version` 1, TELOS) a fixed set of slots
    struct [[eosio::table,eosio::contract("eosio.system")]] rex_balance {
       uint8_t version = 0;
       name    owner;
@@ -629,6 +965,34 @@ namespace eosiosystem {
       int64_t matured_rex = 0;
       std::vector<pair_time_point_sec_int64> rex_maturities; /// REX daily maturity buckets
 
+      // TELOS BEGIN
+      // In the ring layout `rex_maturities` holds one slot per maturity day, indexed by day, followed by the savings
+      // slot. REX matures 5 days after the end of the day it was bought, so no more than 5 days can be pending.
+      // Empty slots have a zero time, so buying, maturing and moving REX never resizes the row.
+      static constexpr uint8_t  ring_version   = 1;
+      static constexpr uint32_t maturity_slots = 5;
+      static constexpr uint32_t savings_slot   = maturity_slots;
+
+      bool ring_layout()const { return version == ring_version; }
+
+      static uint32_t maturity_slot( const time_point_sec& maturity ) {
+         return ( maturity.sec_since_epoch() / seconds_per_day ) % maturity_slots;
+      }
+
+      void add_maturity( const time_point_sec& maturity, int64_t rex ) {
+         if ( ring_layout() ) {
+            auto& slot = rex_maturities[ maturity_slot( maturity ) ];
+            check( slot.first == time_point_sec() || slot.first == maturity, "maturity slot in use" ); // should never happen
+            slot.first   = maturity;
+            slot.second += rex;
+         } else if ( !rex_maturities.empty() && rex_maturities.back().first == maturity ) {
+            rex_maturities.back().second += rex;
+         } else {
+            rex_maturities.emplace_back( pair_time_point_sec_int64{ maturity, rex } );
+         }
+      }
+      // TELOS END
+
       uint64_t primary_key()const { return owner.value; }
    };
 
@@ -692,6 +1056,14 @@ namespace eosiosystem {
       asset stake_change;
    };
 
+   // TELOS BEGIN
+   // Pending changes to a voter row, written together with the vote update instead of in separate modifies
+   struct voter_stake_delta {
+      int64_t staked    = 0; // added to voter_info::staked
+      int64_t delegated = 0; // added to the delegated stake total when the voter row tracks it
+   };
+   // TELOS END
+
    struct powerup_config_resource {
       std::optional<int64_t>        current_weight_ratio;   // Immediately set weight_ratio to this amount. 1x = 10^15. 0.01x = 10^13.
                                                             //    Do not specify to preserve the existing setting or use the default;
@@ -809,6 +1181,26 @@ namespace eosiosystem {
                                indexed_by<"byexpires"_n, const_mem_fun<powerup_order, uint64_t, &powerup_order::by_expires>>
                                > powerup_order_table;
 
+   /**
+    * Remembers the serialized form of a cached singleton value as it was loaded, so that it is only written back
+    * when an action actually modified it. A singleton that did not exist yet always counts as changed.
+    */
+   class singleton_image {
+      public:
+         template<typename T>
+         void capture( const T& value, bool exists ) {
+            _data = exists ? eosio::pack( value ) : std::vector<char>{};
+         }
+
+         template<typename T>
+         bool changed( const T& value )const {
+            return _data.empty() || eosio::pack( value ) != _data;
+         }
+
+      private:
+         std::vector<char> _data;
+   };
+
    /**
     * The `eosio.system` smart contract is provided by `block.one` as a sample system contract, and it defines the structures and actions needed for blockchain's core functionality.
     *
@@ -844,15 +1236,32 @@ namespace eosiosystem {
          rex_fund_table           _rexfunds;
          rex_balance_table        _rexbalance;
          rex_order_table          _rexorders;
+         singleton_image          _gstate_image;
+         singleton_image          _gstate2_image;
+         singleton_image          _gstate3_image;
+         singleton_image          _gstate4_image;
 
          // TELOS BEGIN
-         schedule_metrics_singleton  _schedule_metrics;
-         schedule_metrics_state      _gschedule_metrics;
-         rotation_singleton          _rotation;
-         rotation_state              _grotation;
-         payrate_singleton           _payrate;
-         payrates                    _gpayrate;
-         payments_table              _payments;
+         schedule_metrics_singleton            _schedule_metrics;
+         std::optional<schedule_metrics_state> _gschedule_metrics; // loaded on first use, see get_schedule_metrics
+         rotation_singleton                    _rotation;
+         std::optional<rotation_state>         _grotation;         // loaded on first use, see get_rotation
+         payrate_singleton                     _payrate;
+         std::optional<payrates>               _gpayrate;          // loaded on first use, see get_payrate
+         payments_table                        _payments;
+         election_state_singleton              _election;
+         std::optional<election_state>         _gelection;         // loaded on first use, see get_election_state
+         bool                                  _gelection_seeded = false; // the electstate row exists or initelect ran
+         std::optional<bool>                   _fixed_point_votes; // loaded on first use, see fixed_point_votes
+         std::optional<bool>                   _journal_votes;     // loaded on first use, see journal_votes
+         std::optional<uint8_t>                _compact_votes;     // loaded on first use, see compact_votes
+         std::map<uint16_t, name>              _producer_id_names; // prodids rows read by this action, see producer_id_owner
+         std::optional<rex_pool>               _grexpool;          // loaded on first use, see get_rex_pool
+         singleton_image                       _gschedule_metrics_image;
+         singleton_image                       _grotation_image;
+         singleton_image                       _gpayrate_image;
+         singleton_image                       _gelection_image;
+         singleton_image                       _grexpool_image;
          // TELOS END
 
       public:
@@ -1171,9 +1580,39 @@ namespace eosiosystem {
           *
           * @param user - any account can execute this action,
           * @param max - number of each of CPU loans, NET loans, and sell orders to be processed.
+          * @param budget - (TELOS) optional work units to spend, processing stops once they are used up. When it is
+          *    given, the work spent and the remaining backlog are reported with the `execresult` inline action.
+          */
+         [[eosio::action]]
+         void rexexec( const name& user, uint16_t max, const binary_extension<uint32_t>& budget );
+
+         // TELOS BEGIN
+         /**
+          * Set REX keeper mode action. While keeper mode is on, REX actions of users no longer process expired
+          * loans and sell orders themselves; an off-chain keeper is expected to push `rexexec`, which any account
+          * may do. The processing is not done in `onblock`, where a failing loan or order would abort the block.
+          *
+          * @param enabled - true to leave the processing to rexexec, false to let REX actions of users do it again.
+          */
+         [[eosio::action]]
+         void setrexkeep( bool enabled );
+
+         /**
+          * Migrate REX return buckets action, converts the `retbuckets` row to the fixed size ring layout.
           */
          [[eosio::action]]
-         void rexexec( const name& user, uint16_t max );
+         void migretbucket();
+
+         /**
+          * Migrate REX balances action, converts the maturity buckets of the `owners` REX balances to the
+          * fixed size ring layout. The amounts of REX and their maturities are left unchanged. Requires the
+          * authority of the system account.
+          *
+          * @param owners - accounts whose REX balances are converted.
+          */
+         [[eosio::action]]
+         void migrexbal( const std::vector<name>& owners );
+         // TELOS END
 
          /**
           * Consolidate action, consolidates REX maturity buckets into one bucket that can be sold after 4 days
@@ -1293,6 +1732,27 @@ namespace eosiosystem {
          [[eosio::action]]
          void refund( const name& owner );
 
+         // TELOS BEGIN
+         /**
+          * Execute refunds action, pays the matured refunds of the listed `owners`. Anyone can push it, owners
+          * whose refund is not queued or not matured yet are skipped. A refund that cannot be paid, for example
+          * because the owner rejects the transfer, fails the whole action: the keeper leaves that owner out of
+          * its next call and the owner claims it with the `refund` action instead.
+          *
+          * @param owners - accounts to refund, at most `exec_max` of the `refundcfg` settings.
+          */
+         [[eosio::action]]
+         void refundexec( const std::vector<name>& owners );
+
+         /**
+          * Set refund settings action, sets the number of owners a single `refundexec` may pay.
+          *
+          * @param exec_max - maximum number of owners per refundexec, must be positive.
+          */
+         [[eosio::action]]
+         void setrefundcfg( uint16_t exec_max );
+         // TELOS END
+
          // functions defined in voting.cpp
 
          /**
@@ -1486,6 +1946,26 @@ namespace eosiosystem {
          [[eosio::action]]
          void bidrefund( const name& bidder, const name& newname );
 
+         // TELOS BEGIN
+         /**
+          * Claim bid refund action, pays the account `bidder` everything it was outbid by, on all names.
+          *
+          * @param bidder - the account that gets refunded.
+          */
+         [[eosio::action]]
+         void claimbidref( const name& bidder );
+
+         /**
+          * Execute bid refunds action, pays the pending bid refunds of the listed `bidders`. Anyone can push it,
+          * bidders with nothing owed are skipped. A bidder rejecting the transfer fails the whole action, so it
+          * is left out of the next call and claims its refund with `claimbidref` instead.
+          *
+          * @param bidders - accounts to refund.
+          */
+         [[eosio::action]]
+         void bidrefexec( const std::vector<name>& bidders );
+         // TELOS END
+
          /**
           * Change the annual inflation rate of the core token supply and specify how
           * the new issued tokens will be distributed based on the following structure.
@@ -1574,6 +2054,9 @@ namespace eosiosystem {
          using updaterex_action = eosio::action_wrapper<"updaterex"_n, &system_contract::updaterex>;
          using rexexec_action = eosio::action_wrapper<"rexexec"_n, &system_contract::rexexec>;
          using setrex_action = eosio::action_wrapper<"setrex"_n, &system_contract::setrex>;
+         using setrexkeep_action = eosio::action_wrapper<"setrexkeep"_n, &system_contract::setrexkeep>; // TELOS
+         using migretbucket_action = eosio::action_wrapper<"migretbucket"_n, &system_contract::migretbucket>; // TELOS
+         using migrexbal_action = eosio::action_wrapper<"migrexbal"_n, &system_contract::migrexbal>; // TELOS
          using mvtosavings_action = eosio::action_wrapper<"mvtosavings"_n, &system_contract::mvtosavings>;
          using mvfrsavings_action = eosio::action_wrapper<"mvfrsavings"_n, &system_contract::mvfrsavings>;
          using consolidate_action = eosio::action_wrapper<"consolidate"_n, &system_contract::consolidate>;
@@ -1583,6 +2066,8 @@ namespace eosiosystem {
          using buyrambytes_action = eosio::action_wrapper<"buyrambytes"_n, &system_contract::buyrambytes>;
          using sellram_action = eosio::action_wrapper<"sellram"_n, &system_contract::sellram>;
          using refund_action = eosio::action_wrapper<"refund"_n, &system_contract::refund>;
+         using refundexec_action = eosio::action_wrapper<"refundexec"_n, &system_contract::refundexec>; // TELOS
+         using setrefundcfg_action = eosio::action_wrapper<"setrefundcfg"_n, &system_contract::setrefundcfg>; // TELOS
          using regproducer_action = eosio::action_wrapper<"regproducer"_n, &system_contract::regproducer>;
          using regproducer2_action = eosio::action_wrapper<"regproducer2"_n, &system_contract::regproducer2>;
          using unregprod_action = eosio::action_wrapper<"unregprod"_n, &system_contract::unregprod>;
@@ -1596,6 +2081,8 @@ namespace eosiosystem {
          using updtrevision_action = eosio::action_wrapper<"updtrevision"_n, &system_contract::updtrevision>;
          using bidname_action = eosio::action_wrapper<"bidname"_n, &system_contract::bidname>;
          using bidrefund_action = eosio::action_wrapper<"bidrefund"_n, &system_contract::bidrefund>;
+         using claimbidref_action = eosio::action_wrapper<"claimbidref"_n, &system_contract::claimbidref>;
+         using bidrefexec_action = eosio::action_wrapper<"bidrefexec"_n, &system_contract::bidrefexec>;
          using setpriv_action = eosio::action_wrapper<"setpriv"_n, &system_contract::setpriv>;
          using setalimits_action = eosio::action_wrapper<"setalimits"_n, &system_contract::setalimits>;
          using setparams_action = eosio::action_wrapper<"setparams"_n, &system_contract::setparams>;
@@ -1617,11 +2104,103 @@ namespace eosiosystem {
          [[eosio::action]]
          void distviarex(name from, asset amount);
 
+         /**
+          * Migrate producer block counters action, moves `unpaid_blocks` and `lifetime_produced_blocks` of up to
+          * `max` producers registered before the `prodstats` table existed into it. Each call resumes after the
+          * last producer visited by the previous one.
+          *
+          * @param max - maximum number of producers to visit.
+          */
+         [[eosio::action]]
+         void migprodstats( uint16_t max );
+
+         /**
+          * Initialize election state action, counts the active producers once into the `electstate` singleton
+          * on a chain upgraded from a version without it. Until then every ranking pass walks up to
+          * MAX_PRODUCERS producers and proposes its schedule unconditionally, as before. New chains are
+          * initialized by `init`.
+          */
+         [[eosio::action]]
+         void initelect();
+
+         /**
+          * Set fixed point votes action, switches vote weights to integer arithmetic so that vote totals are
+          * exact and cannot drift, then starts a recount of all votes with the new weights. Cannot be undone.
+          */
+         [[eosio::action]]
+         void setfixedvote();
+
+         /**
+          * Migrate votes to producer ids action, assigns ids to up to `max` producers or converts the votes of up
+          * to `max` voters to the compact producer id form. Push repeatedly until the migration is done.
+          *
+          * @param max - maximum number of producers or voters to process.
+          */
+         [[eosio::action]]
+         void migvoterids( uint16_t max );
+
+         /**
+          * Sync delegated stake action, recomputes the total stake each of `owners` has delegated from their
+          * delegated bandwidth rows and stores it in their voter row, so that voteupdate no longer scans them.
+          *
+          * @param owners - accounts to reconcile.
+          */
+         [[eosio::action]]
+         void syncdelband( const std::vector<name>& owners );
+
+         /**
+          * Batch vote update action, refreshes the vote stake of up to `max` voters like voteupdate does,
+          * continuing from where the previous call stopped and wrapping around at the end of the voters table.
+          * Vote changes of voters who vote for producers directly are summed and written once per producer.
+          *
+          * @param max - maximum number of voters to refresh.
+          */
+         [[eosio::action]]
+         void voteupdbatch( uint16_t max );
+
+         /**
+          * Set vote journal action, when enabled the vote changes of producers are collected in the
+          * `votejournal` table and written to the producers once per block by onblock.
+          *
+          * @param enabled - whether vote changes are journaled.
+          */
+         [[eosio::action]]
+         void setvotejrnl( bool enabled );
+
+         /**
+          * Migrate proxy index action, rewrites up to `max` voters so that those using a proxy are listed in the
+          * `byproxy` index. Voters without a proxy are left as they are: while proxy registration is disabled
+          * they cannot set one. Push repeatedly until the migration is done.
+          *
+          * @param max - maximum number of voters to visit.
+          */
+         [[eosio::action]]
+         void migproxyidx( uint16_t max );
+
+         /**
+          * Sync proxy action, recomputes the weight delegated to `proxy` from its own delegators, read through
+          * the `byproxy` index, and updates the votes of the proxy when it differs. Requires the proxy index
+          * migration to be done.
+          *
+          * @param proxy - the proxy account to reconcile.
+          */
+         [[eosio::action]]
+         void syncproxy( const name& proxy );
+
 
          using unregreason_action = eosio::action_wrapper<"unregreason"_n, &system_contract::unregreason>;
          using votebpout_action = eosio::action_wrapper<"votebpout"_n, &system_contract::votebpout>;
          using setpayrates_action = eosio::action_wrapper<"setpayrates"_n, &system_contract::setpayrates>;
          using distviarex_action = eosio::action_wrapper<"distviarex"_n, &system_contract::distviarex>;
+         using migprodstats_action = eosio::action_wrapper<"migprodstats"_n, &system_contract::migprodstats>;
+         using initelect_action = eosio::action_wrapper<"initelect"_n, &system_contract::initelect>;
+         using setfixedvote_action = eosio::action_wrapper<"setfixedvote"_n, &system_contract::setfixedvote>;
+         using migvoterids_action = eosio::action_wrapper<"migvoterids"_n, &system_contract::migvoterids>;
+         using syncdelband_action = eosio::action_wrapper<"syncdelband"_n, &system_contract::syncdelband>;
+         using voteupdbatch_action = eosio::action_wrapper<"voteupdbatch"_n, &system_contract::voteupdbatch>;
+         using setvotejrnl_action = eosio::action_wrapper<"setvotejrnl"_n, &system_contract::setvotejrnl>;
+         using migproxyidx_action = eosio::action_wrapper<"migproxyidx"_n, &system_contract::migproxyidx>;
+         using syncproxy_action = eosio::action_wrapper<"syncproxy"_n, &system_contract::syncproxy>;
          // TELOS END
 
       private:
@@ -1638,10 +2217,25 @@ namespace eosiosystem {
          static eosio_global_state4 get_default_inflation_parameters();
          symbol core_symbol()const;
          void update_ram_supply();
+         // TELOS BEGIN
+         schedule_metrics_state& get_schedule_metrics();
+         rotation_state& get_rotation();
+         payrates& get_payrate();
+         election_state& get_election_state();
+         void seed_election_state();
+         bool fixed_point_votes();
+         bool journal_votes();
+         uint8_t compact_votes();
+         rex_pool& get_rex_pool();
+         // TELOS END
 
          // defined in rex.cpp
-         void runrex( uint16_t max );
+         uint32_t runrex( uint16_t max, uint32_t budget = runrex_no_budget );
+         uint32_t rex_backlog()const;
+         uint16_t user_runrex_max()const;
          void update_rex_pool();
+         void update_rex_return_ring( bool new_return_bucket, const pair_time_point_sec_int64& new_bucket,
+                                      const time_point_sec& effective_time, int64_t& change_estimate );
          void update_resource_limits( const name& from, const name& receiver, int64_t delta_net, int64_t delta_cpu );
          void check_voting_requirement( const name& owner,
                                         const char* error_msg = "must vote for at least 21 producers or for a proxy before buying REX" )const;
@@ -1658,8 +2252,12 @@ namespace eosiosystem {
          void transfer_from_fund( const name& owner, const asset& amount );
          void transfer_to_fund( const name& owner, const asset& amount );
          bool rex_loans_available()const;
-         bool rex_system_initialized()const { return _rexpool.begin() != _rexpool.end(); }
-         bool rex_available()const { return rex_system_initialized() && _rexpool.begin()->total_rex.amount > 0; }
+         bool rex_system_initialized()const { return _grexpool || _rexpool.begin() != _rexpool.end(); }
+         bool rex_available()const {
+            if ( _grexpool ) return _grexpool->total_rex.amount > 0;
+            auto itr = _rexpool.begin();
+            return itr != _rexpool.end() && itr->total_rex.amount > 0;
+         }
          static time_point_sec get_rex_maturity();
          asset add_to_rex_balance( const name& owner, const asset& payment, const asset& rex_received );
          asset add_to_rex_pool( const asset& payment );
@@ -1670,6 +2268,7 @@ namespace eosiosystem {
          int64_t read_rex_savings( const rex_balance_table::const_iterator& bitr );
          void put_rex_savings( const rex_balance_table::const_iterator& bitr, int64_t rex );
          void update_rex_stake( const name& voter );
+         int64_t refresh_rex_vote_stake( const name& voter );
 
          void add_loan_to_rex_pool( const asset& payment, int64_t rented_tokens, bool new_loan );
          void remove_loan_from_rex_pool( const rex_loan& loan );
@@ -1679,12 +2278,28 @@ namespace eosiosystem {
          // defined in delegate_bandwidth.cpp
          void changebw( name from, const name& receiver,
                         const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer );
-         void update_voting_power( const name& voter, const asset& total_update );
+         void update_voting_power( const name& voter, const asset& total_update, int64_t delegated_update = 0 );
+         void update_delegated_out( const name& owner, int64_t delta );
+         void queue_refund( const name& owner, const time_point_sec& request_time, bool pending );
+         static void apply_voter_stake_delta( voter_info& voter, const voter_stake_delta& delta );
 
          // defined in voting.cpp
          void register_producer( const name& producer, const eosio::block_signing_authority& producer_authority, const std::string& url, uint16_t location );
+         void on_producer_deactivate( const producer_info& prod );
+         uint16_t assign_producer_id( const name& producer, const name& payer );
+         name producer_id_owner( uint16_t id );
+         std::vector<name> get_voter_producers( const voter_info& voter );
+         std::vector<name> get_voter_producers( const voter_info& voter, const std::vector<name>& producers,
+                                                const std::vector<uint16_t>& producer_ids );
+         int64_t get_delegated_out( const voter_info& voter );
+         int64_t sync_delegated_out( const voter_info& voter );
+         void add_producer_votes( const producer_info& prod, double delta );
+         bool affects_ranking( const producer_info& prod, double old_total, double new_total );
+         void fold_vote_journal();
+         bool to_producer_ids( const std::vector<name>& producers, std::vector<uint16_t>& ids );
          void update_elected_producers( const block_timestamp& timestamp );
-         void update_votes( const name& voter, const name& proxy, const std::vector<name>& producers, bool voting );
+         void update_votes( const name& voter, const name& proxy, const std::vector<name>& producers, bool voting,
+                            const voter_stake_delta& pending = {} );
          void propagate_weight_change( const voter_info& voter );
          double update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
                                                const time_point& ct,
@@ -1738,16 +2353,22 @@ namespace eosiosystem {
          // defined in producer_pay.cpp
          void claimrewards_snapshot();
 
+         // defined in name_bidding.cpp
+         void update_top_bid( const name_bid& bid );
+         top_bid refresh_top_bid();
+
 
          double inverse_vote_weight(double staked, double amountVotedProducers);
          void recalculate_votes();
+         void apply_recalc_vote_delta( vote_recalc_state& recalc, const name& producer, double delta );
 
          //defined in system_kick.cpp
          bool crossed_missed_blocks_threshold(uint32_t amountBlocksMissed, uint32_t schedule_size);
          void reset_schedule_metrics(name producer);
-         void update_producer_missed_blocks(name producer);
-         bool is_new_schedule_activated(name active_schedule[], uint32_t size);
-         bool is_new_schedule_activated(std::vector<name>& schedule);
+         producer_metric* find_producer_metric(block_timestamp timestamp, name producer);
+         void update_producer_missed_blocks(block_timestamp timestamp, name producer);
+         bool is_new_schedule_activated(std::vector<name>& active_schedule);
+         bool is_proposed_schedule_active();
          bool check_missed_blocks(block_timestamp timestamp, name producer);
 
          //define in system_rotation.cpp
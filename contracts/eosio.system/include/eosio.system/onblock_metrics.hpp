@@ -0,0 +1,160 @@
+#pragma once
+
+/**
+ * Optional instrumentation of the onblock action, enabled with the SYSTEM_ONBLOCK_METRICS CMake option.
+ *
+ * WebAssembly contracts have no access to a clock with sub-action resolution, so elapsed time cannot be measured.
+ * Instead, each stage of onblock counts the work it does: how many times it ran, the table rows it read and wrote
+ * and the inline actions it sent. The counts are accumulated into the `onblockstat` singleton over a rolling window
+ * of blocks; when a window is full it becomes the `previous` window and a new `current` window starts, so
+ * operators always have one complete window to compare against with get_table_rows.
+ *
+ * When the option is disabled, every macro below expands to nothing and the table is not part of the ABI.
+ */
+
+#ifdef SYSTEM_ONBLOCK_METRICS
+
+#include <eosio/eosio.hpp>
+#include <eosio/singleton.hpp>
+#include <eosio/time.hpp>
+
+#include <vector>
+
+namespace eosiosystem {
+
+   enum class onblock_stage : uint8_t {
+      none             = 0,
+      blockinfo        = 1,
+      missed_blocks    = 2,
+      producer_blocks  = 3,
+      recalc_votes     = 4,
+      elect_producers  = 5,
+      name_close       = 6,
+      rewards_snapshot = 7,
+      vote_journal     = 8,
+      count            = 9
+   };
+
+   static constexpr uint32_t onblock_stats_window = 7200; // blocks, one hour at 0.5s per block
+
+   struct onblock_stage_stat {
+      uint64_t invocations    = 0;
+      uint64_t rows_read      = 0;
+      uint64_t rows_written   = 0;
+      uint64_t inline_actions = 0;
+
+      EOSLIB_SERIALIZE( onblock_stage_stat, (invocations)(rows_read)(rows_written)(inline_actions) )
+   };
+
+   /**
+    * Work done by onblock, one entry per `onblock_stage` (index 0 accounts for work done outside any stage).
+    */
+   struct [[eosio::table("onblockstat"), eosio::contract("eosio.system")]] onblock_stats {
+      eosio::block_timestamp           window_start;
+      uint32_t                         window_blocks = 0;
+      std::vector<onblock_stage_stat>  current;
+      std::vector<onblock_stage_stat>  previous;
+
+      EOSLIB_SERIALIZE( onblock_stats, (window_start)(window_blocks)(current)(previous) )
+   };
+
+   typedef eosio::singleton< "onblockstat"_n, onblock_stats > onblock_stats_singleton;
+
+   /**
+    * Counters for the onblock action being executed. Counting only happens between `begin_block` and `end_block`,
+    * so helpers shared with regular actions can be instrumented without polluting the statistics.
+    */
+   class onblock_metrics {
+      public:
+         static onblock_metrics& get() {
+            static onblock_metrics metrics;
+            return metrics;
+         }
+
+         void begin_block() {
+            _active = true;
+            _stage  = onblock_stage::none;
+            for( auto& s : _block ) s = onblock_stage_stat{};
+         }
+
+         void end_block( eosio::name self, eosio::block_timestamp timestamp ) {
+            _active = false;
+
+            onblock_stats_singleton stats_sing( self, self.value );
+            auto stats = stats_sing.get_or_default();
+            if( stats.window_blocks >= onblock_stats_window || stats.current.size() != size_t(onblock_stage::count) ) {
+               stats.previous      = std::move( stats.current );
+               stats.current       = std::vector<onblock_stage_stat>( size_t(onblock_stage::count) );
+               stats.window_start  = timestamp;
+               stats.window_blocks = 0;
+            }
+            ++stats.window_blocks;
+            for( size_t i = 0; i < stats.current.size(); ++i ) {
+               stats.current[i].invocations    += _block[i].invocations;
+               stats.current[i].rows_read      += _block[i].rows_read;
+               stats.current[i].rows_written   += _block[i].rows_written;
+               stats.current[i].inline_actions += _block[i].inline_actions;
+            }
+            stats_sing.set( stats, self );
+         }
+
+         onblock_stage enter( onblock_stage stage ) {
+            const auto prev = _stage;
+            _stage = stage;
+            if( _active ) ++current().invocations;
+            return prev;
+         }
+
+         void leave( onblock_stage prev ) { _stage = prev; }
+
+         void rows_read( uint64_t n )      { if( _active ) current().rows_read += n; }
+         void rows_written( uint64_t n )   { if( _active ) current().rows_written += n; }
+         void inline_actions( uint64_t n ) { if( _active ) current().inline_actions += n; }
+
+      private:
+         onblock_stage_stat& current() { return _block[size_t(_stage)]; }
+
+         bool                _active = false;
+         onblock_stage       _stage  = onblock_stage::none;
+         onblock_stage_stat  _block[size_t(onblock_stage::count)];
+   };
+
+   // Counts a whole onblock and folds the counters into the onblockstat table when it goes out of scope
+   class onblock_metrics_block {
+      public:
+         onblock_metrics_block( eosio::name self, eosio::block_timestamp timestamp )
+         :_self(self), _timestamp(timestamp) { onblock_metrics::get().begin_block(); }
+         ~onblock_metrics_block() { onblock_metrics::get().end_block( _self, _timestamp ); }
+
+      private:
+         eosio::name             _self;
+         eosio::block_timestamp  _timestamp;
+   };
+
+   // Attributes everything counted while in scope to `stage`, restoring the enclosing stage on exit
+   class onblock_metrics_stage {
+      public:
+         explicit onblock_metrics_stage( onblock_stage stage ) :_prev( onblock_metrics::get().enter( stage ) ) {}
+         ~onblock_metrics_stage() { onblock_metrics::get().leave( _prev ); }
+
+      private:
+         onblock_stage _prev;
+   };
+
+} /// namespace eosiosystem
+
+#define ONBLOCK_METRICS_BLOCK(self, timestamp) ::eosiosystem::onblock_metrics_block _onblock_metrics_block{ self, timestamp }
+#define ONBLOCK_STAGE(stage)                   ::eosiosystem::onblock_metrics_stage _onblock_metrics_stage{ ::eosiosystem::onblock_stage::stage }
+#define ONBLOCK_ROWS_READ(n)                   ::eosiosystem::onblock_metrics::get().rows_read( n )
+#define ONBLOCK_ROWS_WRITTEN(n)                ::eosiosystem::onblock_metrics::get().rows_written( n )
+#define ONBLOCK_INLINE_ACTIONS(n)              ::eosiosystem::onblock_metrics::get().inline_actions( n )
+
+#else
+
+#define ONBLOCK_METRICS_BLOCK(self, timestamp)
+#define ONBLOCK_STAGE(stage)
+#define ONBLOCK_ROWS_READ(n)
+#define ONBLOCK_ROWS_WRITTEN(n)
+#define ONBLOCK_INLINE_ACTIONS(n)
+
+#endif
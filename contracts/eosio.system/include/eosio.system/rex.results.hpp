@@ -9,8 +9,8 @@ using eosio::asset;
 using eosio::name;
 
 /**
- * The actions `buyresult`, `sellresult`, `rentresult`, and `orderresult` of `rex.results` are all no-ops.
- * They are added as inline convenience actions to `rentnet`, `rentcpu`, `buyrex`, `unstaketorex`, and `sellrex`.
+ * The actions `buyresult`, `sellresult`, `rentresult`, `orderresult` and `execresult` of `rex.results` are all no-ops.
+ * They are added as inline convenience actions to `rentnet`, `rentcpu`, `buyrex`, `unstaketorex`, `sellrex` and `rexexec`.
  * An inline convenience action does not have any effect, however,
  * its data includes the result of the parent action and appears in its trace.
  */
@@ -52,8 +52,18 @@ class [[eosio::contract("rex.results")]] rex_results : eosio::contract {
       [[eosio::action]]
       void rentresult( const asset& rented_tokens );
 
+      /**
+       * Execresult action.
+       *
+       * @param work_spent - work units spent processing loans and sell orders
+       * @param backlog - due loans and open sell orders left, counted up to a limit
+       */
+      [[eosio::action]]
+      void execresult( uint32_t work_spent, uint32_t backlog );
+
       using buyresult_action   = action_wrapper<"buyresult"_n,   &rex_results::buyresult>;
       using sellresult_action  = action_wrapper<"sellresult"_n,  &rex_results::sellresult>;
       using orderresult_action = action_wrapper<"orderresult"_n, &rex_results::orderresult>;
       using rentresult_action  = action_wrapper<"rentresult"_n,  &rex_results::rentresult>;
+      using execresult_action  = action_wrapper<"execresult"_n,  &rex_results::execresult>;
 };
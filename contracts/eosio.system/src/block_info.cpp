@@ -28,6 +28,7 @@ void system_contract::add_to_blockinfo_table(const eosio::checksum256&    previo
          r.block_height    = new_block_height;
          r.block_timestamp = new_block_timestamp;
       });
+      ONBLOCK_ROWS_WRITTEN(1);
    }
 
    // Erase up to two entries that have fallen out of the rolling window.
@@ -41,6 +42,7 @@ void system_contract::add_to_blockinfo_table(const eosio::checksum256&    previo
         --count)                                                                    //
    {
       itr = t.erase(itr);
+      ONBLOCK_ROWS_WRITTEN(1);
    }
 }
 
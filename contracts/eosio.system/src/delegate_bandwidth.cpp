@@ -264,7 +264,7 @@ namespace eosiosystem {
          //create/update/delete refund
          auto net_balance = stake_net_delta;
          auto cpu_balance = stake_cpu_delta;
-         bool need_deferred_trx = false;
+         bool need_refund = false; // TELOS
 
 
          // net and cpu are same sign by assertions in delegatebw and undelegatebw
@@ -299,9 +299,9 @@ namespace eosiosystem {
 
                if ( req->is_empty() ) {
                   refunds_tbl.erase( req );
-                  need_deferred_trx = false;
+                  need_refund = false;
                } else {
-                  need_deferred_trx = true;
+                  need_refund = true;
                }
             } else if ( net_balance.amount < 0 || cpu_balance.amount < 0 ) { //need to create refund
                refunds_tbl.emplace( from, [&]( refund_request& r ) {
@@ -320,22 +320,19 @@ namespace eosiosystem {
                   }
                   r.request_time = current_time_point();
                });
-               need_deferred_trx = true;
+               need_refund = true;
             } // else stake increase requested with no existing row in refunds_tbl -> nothing to do with refunds_tbl
          } /// end if is_delegating_to_self || is_undelegating
 
-         if ( need_deferred_trx ) {
-            eosio::transaction out;
-            out.actions.emplace_back( permission_level{from, active_permission},
-                                      get_self(), "refund"_n,
-                                      from
-            );
-            out.delay_sec = refund_delay_sec;
-            eosio::cancel_deferred( from.value ); // TODO: Remove this line when replacing deferred transactions is fixed
-            out.send( from.value, from, true );
-         } else {
-            eosio::cancel_deferred( from.value );
+         // TELOS BEGIN
+         // matured refunds are paid by the refund or refundexec actions instead of a deferred transaction
+         if ( need_refund ) {
+            queue_refund( from, refunds_tbl.get( from.value ).request_time, true );
+         } else if ( is_delegating_to_self || is_undelegating ) {
+            queue_refund( from, time_point_sec(), false );
          }
+         eosio::cancel_deferred( from.value ); // refund scheduled before the refund queue existed
+         // TELOS END
 
          auto transfer_amount = net_balance + cpu_balance;
          if ( 0 < transfer_amount.amount ) {
@@ -344,25 +341,34 @@ namespace eosiosystem {
          }
       }
 
-      vote_stake_updater( from );
-      update_voting_power( from, stake_net_delta + stake_cpu_delta );
+      // TELOS BEGIN
+      // the REX vote stake refresh, the stake change and the delegated total are written to the voter row at once.
+      // The REX balance is refreshed even without a voter row, which then starts from the delegated stake only.
+      const int64_t delegated_delta = stake_net_delta.amount + stake_cpu_delta.amount;
+      const bool    has_voter       = _voters.find( from.value ) != _voters.end();
+      const int64_t rex_stake_delta = refresh_rex_vote_stake( from );
+      update_voting_power( from, asset( delegated_delta + ( has_voter ? rex_stake_delta : 0 ), core_symbol() ), delegated_delta );
+      // TELOS END
    }
 
-   void system_contract::update_voting_power( const name& voter, const asset& total_update )
+   void system_contract::update_voting_power( const name& voter, const asset& total_update, int64_t delegated_update )
    {
       auto voter_itr = _voters.find( voter.value );
       if( voter_itr == _voters.end() ) {
          voter_itr = _voters.emplace( voter, [&]( auto& v ) {
             v.owner  = voter;
             v.staked = total_update.amount;
+            // TELOS BEGIN
+            // a new voter has no other delegated bandwidth rows
+            v.flags1    = set_field( v.flags1, voter_info::flags1_fields::delegated_tracked, true );
+            v.reserved3 = asset( delegated_update, core_symbol() );
+            // TELOS END
          });
-      } else {
-         _voters.modify( voter_itr, same_payer, [&]( auto& v ) {
-            v.staked += total_update.amount;
-         });
+         check( 0 <= voter_itr->staked, "stake for voting cannot be negative" );
+         return;
       }
 
-      check( 0 <= voter_itr->staked, "stake for voting cannot be negative" );
+      check( 0 <= voter_itr->staked + total_update.amount, "stake for voting cannot be negative" );
 
       /* TELOS BEGIN DELETION
       if( voter == "b1"_n ) {
@@ -370,11 +376,40 @@ namespace eosiosystem {
       }
       TELOS END DELETION */
 
-      if( voter_itr->producers.size() || voter_itr->proxy ) {
-         update_votes( voter, voter_itr->proxy, voter_itr->producers, false );
+      // TELOS BEGIN
+      // a voter that votes gets its stake written by update_votes, together with the new vote weight
+      const voter_stake_delta pending{ total_update.amount, delegated_update };
+      if( voter_itr->producer_count() || voter_itr->proxy ) {
+         update_votes( voter, voter_itr->proxy, get_voter_producers( *voter_itr ), false, pending );
+      } else {
+         _voters.modify( voter_itr, same_payer, [&]( auto& v ) {
+            apply_voter_stake_delta( v, pending );
+         });
+      }
+      // TELOS END
+   }
+
+   // TELOS BEGIN
+   void system_contract::update_delegated_out( const name& owner, int64_t delta ) {
+      auto voter_itr = _voters.find( owner.value );
+      if( voter_itr == _voters.end() ) {
+         return;
       }
+      _voters.modify( voter_itr, same_payer, [&]( auto& v ) {
+         apply_voter_stake_delta( v, voter_stake_delta{ 0, delta } );
+      });
    }
 
+   void system_contract::apply_voter_stake_delta( voter_info& voter, const voter_stake_delta& delta ) {
+      voter.staked += delta.staked;
+      // untracked rows are reconciled from the delegated bandwidth rows by syncdelband or voteupdate
+      if( has_field( voter.flags1, voter_info::flags1_fields::delegated_tracked ) ) {
+         voter.reserved3.amount += delta.delegated;
+         check( 0 <= voter.reserved3.amount, "delegated stake cannot be negative" ); // data corruption
+      }
+   }
+   // TELOS END
+
    void system_contract::delegatebw( const name& from, const name& receiver,
                                      const asset& stake_net_quantity,
                                      const asset& stake_cpu_quantity, bool transfer )
@@ -425,7 +460,64 @@ namespace eosiosystem {
       token::transfer_action transfer_act{ token_account, { {stake_account, active_permission}, {req->owner, active_permission} } };
       transfer_act.send( stake_account, req->owner, req->net_amount + req->cpu_amount, "unstake" );
       refunds_tbl.erase( req );
+      queue_refund( owner, time_point_sec(), false ); // TELOS
+   }
+
+   // TELOS BEGIN
+   void system_contract::queue_refund( const name& owner, const time_point_sec& request_time, bool pending ) {
+      refund_queue_table queue( get_self(), get_self().value );
+      auto qitr = queue.find( owner.value );
+      if ( !pending ) {
+         if ( qitr != queue.end() ) {
+            queue.erase( qitr );
+         }
+         return;
+      }
+
+      const time_point_sec due = request_time + refund_delay_sec;
+      if ( qitr == queue.end() ) {
+         queue.emplace( owner, [&]( auto& q ) {
+            q.owner = owner;
+            q.due   = due;
+         });
+      } else if ( qitr->due != due ) {
+         queue.modify( qitr, same_payer, [&]( auto& q ) {
+            q.due = due;
+         });
+      }
+   }
+
+   void system_contract::refundexec( const std::vector<name>& owners ) {
+      check( !owners.empty(), "no owners to refund" );
+      refund_config_singleton config_sing( get_self(), get_self().value );
+      check( owners.size() <= config_sing.get_or_default().exec_max, "too many owners to refund" );
+
+      const time_point_sec now = current_time_point();
+      refund_queue_table queue( get_self(), get_self().value );
+      for ( const auto& owner : owners ) {
+         auto qitr = queue.find( owner.value );
+         if ( qitr == queue.end() || now < qitr->due ) {
+            continue;
+         }
+         refunds_table refunds_tbl( get_self(), owner.value );
+         auto req = refunds_tbl.find( owner.value );
+         if ( req != refunds_tbl.end() && req->request_time + refund_delay_sec <= now ) {
+            token::transfer_action transfer_act{ token_account, { {stake_account, active_permission} } };
+            transfer_act.send( stake_account, req->owner, req->net_amount + req->cpu_amount, "unstake" );
+            refunds_tbl.erase( req );
+         }
+         queue.erase( qitr );
+      }
+   }
+
+   void system_contract::setrefundcfg( uint16_t exec_max ) {
+      require_auth( get_self() );
+      check( exec_max > 0, "exec_max must be positive" );
+
+      refund_config_singleton config_sing( get_self(), get_self().value );
+      config_sing.set( refund_config{ exec_max }, get_self() );
    }
+   // TELOS END
 
 
 } //namespace eosiosystem
\ No newline at end of file
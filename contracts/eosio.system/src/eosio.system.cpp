@@ -36,20 +36,107 @@ namespace eosiosystem {
     _schedule_metrics(_self, _self.value),
     _rotation(_self, _self.value),
     _payrate(_self, _self.value),
-    _payments(_self, _self.value)
+    _payments(_self, _self.value),
+    _election(_self, _self.value)
     // TELOS END
    {
       _gstate  = _global.exists() ? _global.get() : get_default_parameters();
       _gstate2 = _global2.exists() ? _global2.get() : eosio_global_state2{};
       _gstate3 = _global3.exists() ? _global3.get() : eosio_global_state3{};
       _gstate4 = _global4.exists() ? _global4.get() : get_default_inflation_parameters();
-      // TELOS BEGIN
-      _gschedule_metrics = _schedule_metrics.get_or_create(_self, schedule_metrics_state{ name(0), 0, std::vector<producer_metric>() });
-      _grotation = _rotation.get_or_create(_self, rotation_state{ name(0), name(0), 21, 75, block_timestamp(), block_timestamp() });
-      _gpayrate = _payrate.get_or_create(_self, payrates{ max_bpay_rate, max_worker_monthly_amount });
-      // TELOS END
+
+      _gstate_image.capture( _gstate, _global.exists() );
+      _gstate2_image.capture( _gstate2, _global2.exists() );
+      _gstate3_image.capture( _gstate3, _global3.exists() );
+      _gstate4_image.capture( _gstate4, _global4.exists() );
+   }
+
+   // TELOS BEGIN
+   // The Telos singletons are only needed by block production and a handful of actions, so they are
+   // deserialized on first use instead of for every dispatched action
+   schedule_metrics_state& system_contract::get_schedule_metrics() {
+      if( !_gschedule_metrics ) {
+         const bool exists = _schedule_metrics.exists();
+         _gschedule_metrics = exists ? _schedule_metrics.get() : schedule_metrics_state{ name(0), 0, std::vector<producer_metric>() };
+         _gschedule_metrics_image.capture( *_gschedule_metrics, exists );
+      }
+      return *_gschedule_metrics;
+   }
+
+   rotation_state& system_contract::get_rotation() {
+      if( !_grotation ) {
+         const bool exists = _rotation.exists();
+         _grotation = exists ? _rotation.get() : rotation_state{ name(0), name(0), 21, 75, block_timestamp(), block_timestamp() };
+         _grotation_image.capture( *_grotation, exists );
+      }
+      return *_grotation;
+   }
+
+   payrates& system_contract::get_payrate() {
+      if( !_gpayrate ) {
+         const bool exists = _payrate.exists();
+         _gpayrate = exists ? _payrate.get() : payrates{ max_bpay_rate, max_worker_monthly_amount };
+         _gpayrate_image.capture( *_gpayrate, exists );
+      }
+      return *_gpayrate;
+   }
+
+   election_state& system_contract::get_election_state() {
+      if( !_gelection ) {
+         _gelection_seeded = _election.exists();
+         _gelection = _gelection_seeded ? _election.get() : election_state{};
+         _gelection_image.capture( *_gelection, _gelection_seeded );
+      }
+      return *_gelection;
+   }
+
+   // Counts the active producers once, the count is maintained incrementally afterwards
+   void system_contract::seed_election_state() {
+      auto& election = get_election_state();
+      election.active_producers = 0;
+      for( const auto& p : _producers ) {
+         if( p.active() ) election.active_producers++;
+      }
+      _gelection_seeded = true;
+   }
+
+   // Vote settings are read on every vote but only change in their own actions, so they are cached without write-back
+   bool system_contract::fixed_point_votes() {
+      if( !_fixed_point_votes ) {
+         fixed_vote_singleton fixed_sing( get_self(), get_self().value );
+         _fixed_point_votes = fixed_sing.get_or_default().enabled;
+      }
+      return *_fixed_point_votes;
    }
 
+   bool system_contract::journal_votes() {
+      if( !_journal_votes ) {
+         vote_journal_config_singleton journal_sing( get_self(), get_self().value );
+         _journal_votes = journal_sing.get_or_default().enabled;
+      }
+      return *_journal_votes;
+   }
+
+   uint8_t system_contract::compact_votes() {
+      if( !_compact_votes ) {
+         compact_votes_singleton compact_sing( get_self(), get_self().value );
+         _compact_votes = compact_sing.get_or_default().stage;
+      }
+      return *_compact_votes;
+   }
+
+   // REX helpers update the pool in memory, it is written back once when the action completes
+   rex_pool& system_contract::get_rex_pool() {
+      if( !_grexpool ) {
+         auto itr = _rexpool.begin();
+         check( itr != _rexpool.end(), "rex system not initialized yet" );
+         _grexpool = *itr;
+         _grexpool_image.capture( *_grexpool, true );
+      }
+      return *_grexpool;
+   }
+   // TELOS END
+
    eosio_global_state system_contract::get_default_parameters() {
       eosio_global_state dp;
       get_blockchain_parameters(dp);
@@ -70,14 +157,18 @@ namespace eosiosystem {
    }
 
    system_contract::~system_contract() {
-      _global.set( _gstate, get_self() );
-      _global2.set( _gstate2, get_self() );
-      _global3.set( _gstate3, get_self() );
-      _global4.set( _gstate4, get_self() );
+      if( _gstate_image.changed( _gstate ) )   _global.set( _gstate, get_self() );
+      if( _gstate2_image.changed( _gstate2 ) ) _global2.set( _gstate2, get_self() );
+      if( _gstate3_image.changed( _gstate3 ) ) _global3.set( _gstate3, get_self() );
+      if( _gstate4_image.changed( _gstate4 ) ) _global4.set( _gstate4, get_self() );
       // TELOS BEGIN
-      _schedule_metrics.set(_gschedule_metrics, _self);
-      _rotation.set(_grotation, _self);
-      _payrate.set(_gpayrate, _self);
+      if( _gschedule_metrics && _gschedule_metrics_image.changed( *_gschedule_metrics ) ) _schedule_metrics.set(*_gschedule_metrics, _self);
+      if( _grotation && _grotation_image.changed( *_grotation ) )                         _rotation.set(*_grotation, _self);
+      if( _gpayrate && _gpayrate_image.changed( *_gpayrate ) )                            _payrate.set(*_gpayrate, _self);
+      if( _gelection && _gelection_seeded && _gelection_image.changed( *_gelection ) )    _election.set(*_gelection, _self);
+      if( _grexpool && _grexpool_image.changed( *_grexpool ) ) {
+         _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& rp ) { rp = *_grexpool; });
+      }
       // TELOS END
    }
 
@@ -411,6 +502,7 @@ namespace eosiosystem {
       require_auth( get_self() );
       auto prod = _producers.find( producer.value );
       check( prod != _producers.end(), "producer not found" );
+      on_producer_deactivate( *prod ); // TELOS
       _producers.modify( prod, same_payer, [&](auto& p) {
             p.deactivate();
          });
@@ -526,6 +618,11 @@ namespace eosiosystem {
 
       token::open_action open_act{ token_account, { {get_self(), active_permission} } };
       open_act.send( rex_account, core, get_self() );
+
+      // TELOS BEGIN
+      get_payrate(); // materialize the default pay rates so they can be read before the first rewards snapshot
+      seed_election_state();
+      // TELOS END
    }
 
    // TELOS BEGIN
@@ -536,6 +633,7 @@ namespace eosiosystem {
       auto pitr = _producers.find(bp.value);
       check(pitr != _producers.end(), "Producer account was not found");
 
+      on_producer_deactivate(*pitr);
       _producers.modify(pitr, same_payer, [&](auto &p) {
         p.kick(kick_type::BPS_VOTING, penalty_hours);
       });
@@ -545,12 +643,42 @@ namespace eosiosystem {
       require_auth(_self);
       check(worker <= max_worker_monthly_amount, "WPS rate exceeds the max");
       check(bpay <= max_bpay_rate, "BPAY rate exceeds the max");
-      _gpayrate.bpay_rate = bpay;
-      _gpayrate.worker_amount = worker;
+      get_payrate().bpay_rate = bpay;
+      get_payrate().worker_amount = worker;
    }
 
    void system_contract::distviarex(name from, asset amount) {
       system_contract::channel_to_rex(from, amount);
    }
+
+   void system_contract::migprodstats( uint16_t max ) {
+      require_auth(_self);
+
+      prodstats_migration_singleton migration_sing(_self, _self.value);
+      auto migration = migration_sing.get_or_default();
+      producer_stats_table stats(_self, _self.value);
+      auto pitr = _producers.upper_bound(migration.cursor.value);
+      for (uint16_t visited = 0; pitr != _producers.end() && visited < max; ++pitr, ++visited) {
+         migration.cursor = pitr->owner;
+         if (stats.find(pitr->owner.value) != stats.end()) continue;
+
+         stats.emplace(_self, [&](auto &s) {
+            s.owner = pitr->owner;
+            s.unpaid_blocks = pitr->unpaid_blocks;
+            s.lifetime_produced_blocks = pitr->lifetime_produced_blocks;
+         });
+         _producers.modify(pitr, same_payer, [&](auto &p) {
+            p.unpaid_blocks = 0;
+            p.lifetime_produced_blocks = 0;
+         });
+      }
+      migration_sing.set(migration, _self);
+   }
+
+   void system_contract::initelect() {
+      require_auth(_self);
+      check(!_election.exists(), "election state is already initialized");
+      seed_election_state();
+   }
    // TELOS END
 } /// eosio.system
\ No newline at end of file
@@ -1,8 +1,6 @@
 #include <eosio.system/eosio.system.hpp>
 #include <eosio.token/eosio.token.hpp>
 
-#include <eosio/transaction.hpp>
-
 namespace eosiosystem {
 
    using eosio::current_time_point;
@@ -24,7 +22,7 @@ namespace eosiosystem {
       print( name{bidder}, " bid ", bid, " on ", name{newname}, "\n" );
       auto current = bids.find( newname.value );
       if( current == bids.end() ) {
-         bids.emplace( bidder, [&]( auto& b ) {
+         current = bids.emplace( bidder, [&]( auto& b ) {
             b.newname = newname;
             b.high_bidder = bidder;
             b.high_bid = bid.amount;
@@ -35,29 +33,23 @@ namespace eosiosystem {
          check( bid.amount - current->high_bid > (current->high_bid / 10), "must increase bid by 10%" );
          check( current->high_bidder != bidder, "account is already highest bidder" );
 
-         bid_refund_table refunds_table(get_self(), newname.value);
+         // TELOS BEGIN
+         // the outbid amount is owed to the previous bidder until claimed, instead of a deferred bidrefund per bid;
+         // as with bidrefund, the outbidding bidder pays for the row
+         bid_refund_ledger_table ledger(get_self(), get_self().value);
 
-         auto it = refunds_table.find( current->high_bidder.value );
-         if ( it != refunds_table.end() ) {
-            refunds_table.modify( it, same_payer, [&](auto& r) {
+         auto it = ledger.find( current->high_bidder.value );
+         if ( it != ledger.end() ) {
+            ledger.modify( it, same_payer, [&](auto& r) {
                   r.amount += asset( current->high_bid, core_symbol() );
                });
          } else {
-            refunds_table.emplace( bidder, [&](auto& r) {
+            ledger.emplace( bidder, [&](auto& r) {
                   r.bidder = current->high_bidder;
                   r.amount = asset( current->high_bid, core_symbol() );
                });
          }
-
-         eosio::transaction t;
-         t.actions.emplace_back( permission_level{current->high_bidder, active_permission},
-                                 get_self(), "bidrefund"_n,
-                                 std::make_tuple( current->high_bidder, newname )
-         );
-         t.delay_sec = 0;
-         uint128_t deferred_id = (uint128_t(newname.value) << 64) | current->high_bidder.value;
-         eosio::cancel_deferred( deferred_id );
-         t.send( deferred_id, bidder );
+         // TELOS END
 
          bids.modify( current, bidder, [&]( auto& b ) {
             b.high_bidder = bidder;
@@ -65,6 +57,7 @@ namespace eosiosystem {
             b.last_bid_time = current_time_point();
          });
       }
+      update_top_bid( *current ); // TELOS
    }
 
    void system_contract::bidrefund( const name& bidder, const name& newname ) {
@@ -77,4 +70,67 @@ namespace eosiosystem {
       refunds_table.erase( it );
    }
 
+   // TELOS BEGIN
+   void system_contract::update_top_bid( const name_bid& bid ) {
+      top_bid_singleton top_sing(get_self(), get_self().value);
+      if ( !top_sing.exists() ) {
+         refresh_top_bid();
+         return;
+      }
+
+      // same order as the highbid index: highest bid first, then lowest name
+      auto top = top_sing.get();
+      if ( bid.high_bid > top.high_bid || ( bid.high_bid == top.high_bid && bid.newname <= top.newname ) ) {
+         top.newname       = bid.newname;
+         top.high_bid      = bid.high_bid;
+         top.last_bid_time = bid.last_bid_time;
+         top_sing.set( top, get_self() );
+      }
+   }
+
+   top_bid system_contract::refresh_top_bid() {
+      name_bid_table bids(get_self(), get_self().value);
+      auto idx = bids.get_index<"highbid"_n>();
+      auto highest = idx.lower_bound( std::numeric_limits<uint64_t>::max()/2 );
+      ONBLOCK_ROWS_READ( 1 );
+
+      top_bid top;
+      if ( highest != idx.end() && highest->high_bid > 0 ) {
+         top.newname       = highest->newname;
+         top.high_bid      = highest->high_bid;
+         top.last_bid_time = highest->last_bid_time;
+      }
+      top_bid_singleton( get_self(), get_self().value ).set( top, get_self() );
+      ONBLOCK_ROWS_WRITTEN( 1 );
+      return top;
+   }
+
+   void system_contract::claimbidref( const name& bidder ) {
+      require_auth( bidder );
+
+      bid_refund_ledger_table ledger(get_self(), get_self().value);
+      auto it = ledger.find( bidder.value );
+      check( it != ledger.end(), "refund not found" );
+
+      token::transfer_action transfer_act{ token_account, { {names_account, active_permission}, {bidder, active_permission} } };
+      transfer_act.send( names_account, bidder, it->amount, std::string("refund bids on names") );
+      ledger.erase( it );
+   }
+
+   void system_contract::bidrefexec( const std::vector<name>& bidders ) {
+      check( !bidders.empty(), "no bidders to refund" );
+
+      bid_refund_ledger_table ledger(get_self(), get_self().value);
+      for ( const auto& bidder : bidders ) {
+         auto it = ledger.find( bidder.value );
+         if ( it == ledger.end() ) {
+            continue;
+         }
+         token::transfer_action transfer_act{ token_account, { {names_account, active_permission} } };
+         transfer_act.send( names_account, it->bidder, it->amount, std::string("refund bids on names") );
+         ledger.erase( it );
+      }
+   }
+   // TELOS END
+
 }
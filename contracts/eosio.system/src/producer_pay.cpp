@@ -26,14 +26,27 @@ namespace eosiosystem {
       _ds >> timestamp >> producer >> confirmed >> previous_block_id;
       (void)confirmed; // Only to suppress warning since confirmed is not used.
 
+      ONBLOCK_METRICS_BLOCK( get_self(), timestamp );
+
       // Add latest block information to blockinfo table.
-      add_to_blockinfo_table(previous_block_id, timestamp);
+      {
+         ONBLOCK_STAGE( blockinfo );
+         add_to_blockinfo_table(previous_block_id, timestamp);
+      }
 
       // _gstate2.last_block_num is not used anywhere in the system contract code anymore.
       // Although this field is deprecated, we will continue updating it for now until the last_block_num field
       // is eventually completely removed, at which point this line can be removed.
       _gstate2.last_block_num = timestamp;
 
+      // TELOS BEGIN
+      // journaled votes are folded before activation too, votes cast before it are what activates the network
+      {
+         ONBLOCK_STAGE( vote_journal );
+         fold_vote_journal();
+      }
+      // TELOS END
+
       /** until activation, no new rewards are paid */
       // TELOS BEGIN
       _gstate.block_num++;
@@ -50,9 +63,12 @@ namespace eosiosystem {
          _gstate.last_pervote_bucket_fill = current_time_point();
 
       // TELOS BEGIN
-      if(check_missed_blocks(timestamp, producer)) {
-         update_missed_blocks_per_rotation();
-         reset_schedule_metrics(producer);
+      {
+         ONBLOCK_STAGE( missed_blocks );
+         if(check_missed_blocks(timestamp, producer)) {
+            update_missed_blocks_per_rotation();
+            reset_schedule_metrics(producer);
+         }
       }
       // TELOS END
 
@@ -60,42 +76,73 @@ namespace eosiosystem {
        * At startup the initial producer may not be one that is registered / elected
        * and therefore there may be no producer object for them.
        */
-      auto prod = _producers.find( producer.value );
-      if ( prod != _producers.end() ) {
-         _gstate.total_unpaid_blocks++;
-         _producers.modify( prod, same_payer, [&](auto& p ) {
-               p.unpaid_blocks++;
-               p.lifetime_produced_blocks++;  // TELOS
-         });
+      {
+         ONBLOCK_STAGE( producer_blocks );
+         // TELOS BEGIN
+         producer_stats_table stats( get_self(), get_self().value );
+         auto sitr = stats.find( producer.value );
+         ONBLOCK_ROWS_READ( 1 );
+         if ( sitr != stats.end() ) {
+            _gstate.total_unpaid_blocks++;
+            stats.modify( sitr, same_payer, [&](auto& s ) {
+                  s.unpaid_blocks++;
+                  s.lifetime_produced_blocks++;
+            });
+            ONBLOCK_ROWS_WRITTEN( 1 );
+         } else {
+         // TELOS END
+            auto prod = _producers.find( producer.value );
+            ONBLOCK_ROWS_READ( 1 );
+            if ( prod != _producers.end() ) {
+               _gstate.total_unpaid_blocks++;
+               _producers.modify( prod, same_payer, [&](auto& p ) {
+                     p.unpaid_blocks++;
+                     p.lifetime_produced_blocks++;  // TELOS
+               });
+               ONBLOCK_ROWS_WRITTEN( 1 );
+            }
+         }
       }
 
-      recalculate_votes();  // TELOS
+      {
+         ONBLOCK_STAGE( recalc_votes );
+         recalculate_votes();  // TELOS
+      }
 
       /// only update block producers once every minute, block_timestamp is in half seconds
       if( timestamp.slot - _gstate.last_producer_schedule_update.slot > 120 ) {
-         update_elected_producers( timestamp );
+         {
+            ONBLOCK_STAGE( elect_producers );
+            update_elected_producers( timestamp );
+         }
 
          if( (timestamp.slot - _gstate.last_name_close.slot) > blocks_per_day ) {
-            name_bid_table bids(get_self(), get_self().value);
-            auto idx = bids.get_index<"highbid"_n>();
-            auto highest = idx.lower_bound( std::numeric_limits<uint64_t>::max()/2 );
-            if( highest != idx.end() &&
-                highest->high_bid > 0 &&
-                (current_time_point() - highest->last_bid_time) > microseconds(useconds_per_day) &&
+            ONBLOCK_STAGE( name_close );
+            // TELOS BEGIN
+            top_bid_singleton top_sing(get_self(), get_self().value);
+            ONBLOCK_ROWS_READ( 1 );
+            const top_bid highest = top_sing.exists() ? top_sing.get() : refresh_top_bid();
+            if( highest.high_bid > 0 &&
+                (current_time_point() - highest.last_bid_time) > microseconds(useconds_per_day) &&
                 _gstate.thresh_activated_stake_time > time_point() &&
                 (current_time_point() - _gstate.thresh_activated_stake_time) > microseconds(14 * useconds_per_day)
             ) {
                _gstate.last_name_close = timestamp;
-               channel_namebid_to_rex( highest->high_bid );
-               idx.modify( highest, same_payer, [&]( auto& b ){
+               channel_namebid_to_rex( highest.high_bid );
+               name_bid_table bids(get_self(), get_self().value);
+               bids.modify( bids.get( highest.newname.value ), same_payer, [&]( auto& b ){
                   b.high_bid = -b.high_bid;
                });
+               ONBLOCK_ROWS_WRITTEN( 1 );
+               refresh_top_bid();
             }
+            // TELOS END
          }
       }
       // TELOS BEGIN
       //called once per day to set payments snapshot
       if (_gstate.last_claimrewards + uint32_t(3600) <= timestamp.slot) { //172800 blocks in a day
+          ONBLOCK_STAGE( rewards_snapshot );
           claimrewards_snapshot();
           _gstate.last_claimrewards = timestamp.slot;
       }
@@ -258,8 +305,8 @@ namespace eosiosystem {
 
         if (usecs_since_last_fill > 0 && _gstate.last_pervote_bucket_fill > time_point())
         {
-            double bpay_rate = double(_gpayrate.bpay_rate) / double(100000); //NOTE: both bpay_rate and divisor were int64s which evaluated to 0. The divisor must be a double to get percentage.
-            auto to_workers = static_cast<int64_t>((12 * double(_gpayrate.worker_amount) * double(usecs_since_last_fill)) / double(useconds_per_year));
+            double bpay_rate = double(get_payrate().bpay_rate) / double(100000); //NOTE: both bpay_rate and divisor were int64s which evaluated to 0. The divisor must be a double to get percentage.
+            auto to_workers = static_cast<int64_t>((12 * double(get_payrate().worker_amount) * double(usecs_since_last_fill)) / double(useconds_per_year));
             auto to_producers = static_cast<int64_t>((bpay_rate * double(token_supply.amount) * double(usecs_since_last_fill)) / double(useconds_per_year));
             auto new_tokens = to_workers + to_producers;
 
@@ -279,9 +326,12 @@ namespace eosiosystem {
                 issue_tokens = new_tokens;
             }
 
+            ONBLOCK_ROWS_READ( 2 ); // token supply and TEDP balance
+
             if (transfer_tokens > 0) {
                 token::transfer_action transfer_act{ token_account, { tedp_account, active_permission } };
                 transfer_act.send( tedp_account, get_self(), asset(transfer_tokens, core_symbol()), "TEDP: Inflation offset" );
+                ONBLOCK_INLINE_ACTIONS( 1 );
             }
 
             token::transfer_action transfer_act{ token_account, { get_self(), active_permission } };
@@ -289,14 +339,17 @@ namespace eosiosystem {
             if (issue_tokens > 0) {
                 token::issue_action issue_action{ token_account, { get_self(), active_permission }};
                 issue_action.send(get_self(), asset(issue_tokens, core_symbol()), "Issue new TLOS tokens");
+                ONBLOCK_INLINE_ACTIONS( 1 );
             }
 
             if(to_workers > 0) {
                 transfer_act.send(get_self(), works_account, asset(to_workers, core_symbol()), "Transfer worker proposal share to works.decide account");
+                ONBLOCK_INLINE_ACTIONS( 1 );
             }
 
             if(to_producers > 0) {
                 transfer_act.send(get_self(), bpay_account, asset(to_producers, core_symbol()), "Transfer producer share to per-block bucket");
+                ONBLOCK_INLINE_ACTIONS( 1 );
             }
 
             _gstate.perblock_bucket += to_producers;
@@ -311,6 +364,7 @@ namespace eosiosystem {
 
         for (const auto &prod : sortedprods)
         {
+            ONBLOCK_ROWS_READ( 1 );
             if (prod.active() && activecount < MAX_PRODUCERS)   //only count activated producers
                 activecount++;
             else
@@ -324,7 +378,10 @@ namespace eosiosystem {
         auto shareValue = (_gstate.perblock_bucket / sharecount);
         int32_t index = 0;
 
+        producer_stats_table stats(get_self(), get_self().value);
+
         for (const auto &prod : sortedprods) {
+            ONBLOCK_ROWS_READ( 1 );
 
             if (!prod.active()) //skip inactive producers
                 continue;
@@ -340,14 +397,27 @@ namespace eosiosystem {
                 break;
 
             _gstate.perblock_bucket -= pay_amount;
-            _gstate.total_unpaid_blocks -= prod.unpaid_blocks;
+
+            auto sitr = stats.find(prod.owner.value);
+            ONBLOCK_ROWS_READ( 1 );
+            if (sitr != stats.end()) {
+                _gstate.total_unpaid_blocks -= sitr->unpaid_blocks;
+                stats.modify(sitr, same_payer, [&](auto &s) {
+                    s.unpaid_blocks = 0;
+                });
+                ONBLOCK_ROWS_WRITTEN( 1 );
+            } else {
+                _gstate.total_unpaid_blocks -= prod.unpaid_blocks;
+            }
 
             _producers.modify(prod, same_payer, [&](auto &p) {
                 p.last_claim_time = ct;
                 p.unpaid_blocks = 0;
             });
+            ONBLOCK_ROWS_WRITTEN( 1 );
 
             auto itr = _payments.find(prod.owner.value);
+            ONBLOCK_ROWS_READ( 1 );
 
             if (itr == _payments.end()) {
                 _payments.emplace(_self, [&]( auto& a ) { 
@@ -358,6 +428,7 @@ namespace eosiosystem {
                 _payments.modify(itr, same_payer, [&]( auto& a ) {
                     a.pay += asset(pay_amount, core_symbol());
                 });
+            ONBLOCK_ROWS_WRITTEN( 1 );
         }
     }
 
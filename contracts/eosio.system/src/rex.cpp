@@ -3,6 +3,8 @@
 #include <eosio.token/eosio.token.hpp>
 #include <eosio.system/rex.results.hpp>
 
+#include <algorithm>
+
 namespace eosiosystem {
 
    using eosio::current_time_point;
@@ -50,7 +52,7 @@ namespace eosiosystem {
       transfer_from_fund( from, amount );
       const asset rex_received    = add_to_rex_pool( amount );
       const asset delta_rex_stake = add_to_rex_balance( from, amount, rex_received );
-      runrex(2);
+      runrex( user_runrex_max() );
       update_rex_account( from, asset( 0, core_symbol() ), delta_rex_stake );
       // dummy action added so that amount of REX tokens purchased shows up in action trace
       rex_results::buyresult_action buyrex_act( rex_account, std::vector<eosio::permission_level>{ } );
@@ -81,6 +83,7 @@ namespace eosiosystem {
             dbw_table.erase( del_itr );
          }
       }
+      update_delegated_out( owner, -(from_net.amount + from_cpu.amount) ); // TELOS
 
       update_resource_limits( name(0), receiver, -from_net.amount, -from_cpu.amount );
 
@@ -92,7 +95,7 @@ namespace eosiosystem {
       }
       const asset rex_received = add_to_rex_pool( payment );
       auto rex_stake_delta = add_to_rex_balance( owner, payment, rex_received );
-      runrex(2);
+      runrex( user_runrex_max() );
       update_rex_account( owner, asset( 0, core_symbol() ), rex_stake_delta - payment, true );
       // dummy action added so that amount of REX tokens purchased shows up in action trace
       rex_results::buyresult_action buyrex_act( rex_account, std::vector<eosio::permission_level>{ } );
@@ -103,7 +106,7 @@ namespace eosiosystem {
    {
       require_auth( from );
 
-      runrex(2);
+      runrex( user_runrex_max() );
 
       auto bitr = _rexbalance.require_find( from.value, "user must first buyrex" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol,
@@ -212,14 +215,14 @@ namespace eosiosystem {
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex( user_runrex_max() );
 
       auto itr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       const asset init_stake = itr->vote_stake;
 
-      auto rexpool_itr = _rexpool.begin();
-      const int64_t total_rex      = rexpool_itr->total_rex.amount;
-      const int64_t total_lendable = rexpool_itr->total_lendable.amount;
+      const auto&   pool           = get_rex_pool();
+      const int64_t total_rex      = pool.total_rex.amount;
+      const int64_t total_lendable = pool.total_lendable.amount;
       const int64_t rex_balance    = itr->rex_balance.amount;
 
       asset current_stake( 0, core_symbol() );
@@ -241,23 +244,52 @@ namespace eosiosystem {
       check( balance.amount > 0, "balance must be set to have a positive amount" );
       check( balance.symbol == core_symbol(), "balance symbol must be core symbol" );
       check( rex_system_initialized(), "rex system is not initialized" );
-      _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& pool ) {
-         pool.total_rent = balance;
-      });
+      get_rex_pool().total_rent = balance;
    }
 
-   void system_contract::rexexec( const name& user, uint16_t max )
+   void system_contract::rexexec( const name& user, uint16_t max, const binary_extension<uint32_t>& budget )
    {
       require_auth( user );
 
+      // TELOS BEGIN
+      if ( budget.has_value() ) {
+         check( budget.value() > 0, "budget must be positive" );
+         const uint32_t work_spent = runrex( max, budget.value() );
+         rex_results::execresult_action exec_act{ rex_account, std::vector<eosio::permission_level>{ } };
+         exec_act.send( work_spent, rex_backlog() );
+         return;
+      }
+      // TELOS END
       runrex( max );
    }
 
+   // TELOS BEGIN
+   void system_contract::setrexkeep( bool enabled )
+   {
+      require_auth( get_self() );
+      check( rex_system_initialized(), "rex system not initialized yet" );
+
+      rex_config_singleton config_sing( get_self(), get_self().value );
+      auto config = config_sing.get_or_default();
+      config.keeper_mode = enabled;
+      config_sing.set( config, get_self() );
+   }
+
+   /**
+    * @brief Number of loans and orders a REX action of a user processes, none in keeper mode
+    */
+   uint16_t system_contract::user_runrex_max()const
+   {
+      rex_config_singleton config_sing( get_self(), get_self().value );
+      return ( config_sing.exists() && config_sing.get().keeper_mode ) ? 0 : 2;
+   }
+   // TELOS END
+
    void system_contract::consolidate( const name& owner )
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex( user_runrex_max() );
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       asset rex_in_sell_order = update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
@@ -268,7 +300,7 @@ namespace eosiosystem {
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex( user_runrex_max() );
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol, "asset must be a positive amount of (REX, 4)" );
@@ -279,12 +311,33 @@ namespace eosiosystem {
       process_rex_maturities( bitr );
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
          int64_t moved_rex = 0;
-         while ( !rb.rex_maturities.empty() && moved_rex < rex.amount) {
-            const int64_t d_rex = std::min( rex.amount - moved_rex, rb.rex_maturities.back().second );
-            rb.rex_maturities.back().second -= d_rex;
-            moved_rex                       += d_rex;
-            if ( rb.rex_maturities.back().second == 0 ) {
-               rb.rex_maturities.pop_back();
+         if ( rb.ring_layout() ) {
+            // TELOS: take from the latest maturities first, as with the sorted layout
+            while ( moved_rex < rex.amount ) {
+               auto latest = rb.rex_maturities.end();
+               for ( auto it = rb.rex_maturities.begin(); it != rb.rex_maturities.begin() + rex_balance::maturity_slots; ++it ) {
+                  if ( it->first != time_point_sec() && ( latest == rb.rex_maturities.end() || latest->first < it->first ) ) {
+                     latest = it;
+                  }
+               }
+               if ( latest == rb.rex_maturities.end() ) {
+                  break;
+               }
+               const int64_t d_rex = std::min( rex.amount - moved_rex, latest->second );
+               latest->second -= d_rex;
+               moved_rex      += d_rex;
+               if ( latest->second == 0 ) {
+                  *latest = pair_time_point_sec_int64{};
+               }
+            }
+         } else {
+            while ( !rb.rex_maturities.empty() && moved_rex < rex.amount) {
+               const int64_t d_rex = std::min( rex.amount - moved_rex, rb.rex_maturities.back().second );
+               rb.rex_maturities.back().second -= d_rex;
+               moved_rex                       += d_rex;
+               if ( rb.rex_maturities.back().second == 0 ) {
+                  rb.rex_maturities.pop_back();
+               }
             }
          }
          if ( moved_rex < rex.amount ) {
@@ -302,7 +355,7 @@ namespace eosiosystem {
    {
       require_auth( owner );
 
-      runrex(2);
+      runrex( user_runrex_max() );
 
       auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
       check( rex.amount > 0 && rex.symbol == bitr->rex_balance.symbol, "asset must be a positive amount of (REX, 4)" );
@@ -310,23 +363,43 @@ namespace eosiosystem {
       check( rex.amount <= rex_in_savings, "insufficient REX in savings" );
       process_rex_maturities( bitr );
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         const time_point_sec maturity = get_rex_maturity();
-         if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == maturity ) {
-            rb.rex_maturities.back().second += rex.amount;
-         } else {
-            rb.rex_maturities.emplace_back( pair_time_point_sec_int64 { maturity, rex.amount } );
-         }
+         rb.add_maturity( get_rex_maturity(), rex.amount );
       });
       put_rex_savings( bitr, rex_in_savings - rex.amount );
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
    }
 
+   // TELOS BEGIN
+   void system_contract::migrexbal( const std::vector<name>& owners )
+   {
+      require_auth( get_self() );
+
+      for ( const auto& owner : owners ) {
+         auto bitr = _rexbalance.require_find( owner.value, "account has no REX balance" );
+         if ( bitr->ring_layout() ) {
+            continue;
+         }
+         const int64_t rex_in_savings = read_rex_savings( bitr );
+         process_rex_maturities( bitr );
+         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+            std::vector<pair_time_point_sec_int64> pending = std::move( rb.rex_maturities );
+            rb.version        = rex_balance::ring_version;
+            rb.rex_maturities = std::vector<pair_time_point_sec_int64>( rex_balance::savings_slot + 1 );
+            for ( const auto& bucket : pending ) {
+               rb.add_maturity( bucket.first, bucket.second );
+            }
+         });
+         put_rex_savings( bitr, rex_in_savings );
+      }
+   }
+   // TELOS END
+
    void system_contract::closerex( const name& owner )
    {
       require_auth( owner );
 
       if ( rex_system_initialized() )
-         runrex(2);
+         runrex( user_runrex_max() );
 
       update_rex_account( owner, asset( 0, core_symbol() ), asset( 0, core_symbol() ) );
 
@@ -426,7 +499,7 @@ namespace eosiosystem {
    void system_contract::check_voting_requirement( const name& owner, const char* error_msg )const
    {
       auto vitr = _voters.find( owner.value );
-      check( vitr != _voters.end() && ( vitr->proxy || 21 <= vitr->producers.size() ), error_msg );
+      check( vitr != _voters.end() && ( vitr->proxy || 21 <= vitr->producer_count() ), error_msg );
    }
 
    /**
@@ -459,17 +532,16 @@ namespace eosiosystem {
    void system_contract::add_loan_to_rex_pool( const asset& payment, int64_t rented_tokens, bool new_loan )
    {
       add_to_rex_return_pool( payment );
-      _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& rt ) {
-         // add payment to total_rent
-         rt.total_rent.amount    += payment.amount;
-         // move rented_tokens from total_unlent to total_lent
-         rt.total_unlent.amount  -= rented_tokens;
-         rt.total_lent.amount    += rented_tokens;
-         // increment loan_num if a new loan is being created
-         if ( new_loan ) {
-            rt.loan_num++;
-         }
-      });
+      auto& rt = get_rex_pool();
+      // add payment to total_rent
+      rt.total_rent.amount    += payment.amount;
+      // move rented_tokens from total_unlent to total_lent
+      rt.total_unlent.amount  -= rented_tokens;
+      rt.total_lent.amount    += rented_tokens;
+      // increment loan_num if a new loan is being created
+      if ( new_loan ) {
+         rt.loan_num++;
+      }
    }
 
    /**
@@ -479,18 +551,16 @@ namespace eosiosystem {
     */
    void system_contract::remove_loan_from_rex_pool( const rex_loan& loan )
    {
-      const auto& pool = _rexpool.begin();
-      const int64_t delta_total_rent = exchange_state::get_bancor_output( pool->total_unlent.amount,
-                                                                          pool->total_rent.amount,
+      auto& rt = get_rex_pool();
+      const int64_t delta_total_rent = exchange_state::get_bancor_output( rt.total_unlent.amount,
+                                                                          rt.total_rent.amount,
                                                                           loan.total_staked.amount );
-      _rexpool.modify( pool, same_payer, [&]( auto& rt ) {
-         // deduct calculated delta_total_rent from total_rent
-         rt.total_rent.amount    -= delta_total_rent;
-         // move rented tokens from total_lent to total_unlent
-         rt.total_unlent.amount  += loan.total_staked.amount;
-         rt.total_lent.amount    -= loan.total_staked.amount;
-         rt.total_lendable.amount = rt.total_unlent.amount + rt.total_lent.amount;
-      });
+      // deduct calculated delta_total_rent from total_rent
+      rt.total_rent.amount    -= delta_total_rent;
+      // move rented tokens from total_lent to total_unlent
+      rt.total_unlent.amount  += loan.total_staked.amount;
+      rt.total_lent.amount    -= loan.total_staked.amount;
+      rt.total_lendable.amount = rt.total_unlent.amount + rt.total_lent.amount;
    }
 
    /**
@@ -511,15 +581,23 @@ namespace eosiosystem {
    /**
     * @brief Performs maintenance operations on expired NET and CPU loans and sellrex orders
     *
+    * Processing stops when `budget` work units are spent. The item that exhausts the budget is completed, so the
+    * work spent may exceed the budget by the cost of one item.
+    *
     * @param max - maximum number of each of the three categories to be processed
+    * @param budget - work units that can be spent, see `runrex_loan_work`
+    *
+    * @return uint32_t - work units spent
     */
-   void system_contract::runrex( uint16_t max )
+   uint32_t system_contract::runrex( uint16_t max, uint32_t budget )
    {
+      uint32_t work_spent = 0;
+
       check( rex_system_initialized(), "rex system not initialized yet" );
 
       update_rex_pool();
 
-      const auto& pool = _rexpool.begin();
+      auto& pool = get_rex_pool();
 
       auto process_expired_loan = [&]( auto& idx, const auto& itr ) -> std::pair<bool, int64_t> {
          /// update rex_pool in order to delete existing loan
@@ -527,14 +605,16 @@ namespace eosiosystem {
          bool    delete_loan   = false;
          int64_t delta_stake   = 0;
          /// calculate rented tokens at current price
-         int64_t rented_tokens = exchange_state::get_bancor_output( pool->total_rent.amount,
-                                                                    pool->total_unlent.amount,
+         int64_t rented_tokens = exchange_state::get_bancor_output( pool.total_rent.amount,
+                                                                    pool.total_unlent.amount,
                                                                     itr->payment.amount );
          /// conditions for loan renewal
          bool renew_loan = itr->payment <= itr->balance        /// loan has sufficient balance
                         && itr->payment.amount < rented_tokens /// loan has favorable return
                         && rex_loans_available();              /// no pending sell orders
+         work_spent += runrex_loan_work;
          if ( renew_loan ) {
+            work_spent += runrex_renew_work;
             /// update rex_pool in order to account for renewed loan
             add_loan_to_rex_pool( itr->payment, rented_tokens, false );
             /// update renewed loan fields
@@ -544,6 +624,7 @@ namespace eosiosystem {
             delta_stake = -( itr->total_staked.amount );
             /// refund "from" account if the closed loan balance is positive
             if ( itr->balance.amount > 0 ) {
+               work_spent += runrex_refund_work;
                transfer_to_fund( itr->from, itr->balance );
             }
          }
@@ -552,18 +633,16 @@ namespace eosiosystem {
       };
 
       /// transfer from eosio.names to eosio.rex
-      if ( pool->namebid_proceeds.amount > 0 ) {
-         channel_to_rex( names_account, pool->namebid_proceeds );
-         _rexpool.modify( pool, same_payer, [&]( auto& rt ) {
-            rt.namebid_proceeds.amount = 0;
-         });
+      if ( pool.namebid_proceeds.amount > 0 ) {
+         channel_to_rex( names_account, pool.namebid_proceeds );
+         pool.namebid_proceeds.amount = 0;
       }
 
       /// process cpu loans
       {
          rex_cpu_loan_table cpu_loans( get_self(), get_self().value );
          auto cpu_idx = cpu_loans.get_index<"byexpr"_n>();
-         for ( uint16_t i = 0; i < max; ++i ) {
+         for ( uint16_t i = 0; i < max && work_spent < budget; ++i ) {
             auto itr = cpu_idx.begin();
             if ( itr == cpu_idx.end() || itr->expiration > current_time_point() ) break;
 
@@ -580,7 +659,7 @@ namespace eosiosystem {
       {
          rex_net_loan_table net_loans( get_self(), get_self().value );
          auto net_idx = net_loans.get_index<"byexpr"_n>();
-         for ( uint16_t i = 0; i < max; ++i ) {
+         for ( uint16_t i = 0; i < max && work_spent < budget; ++i ) {
             auto itr = net_idx.begin();
             if ( itr == net_idx.end() || itr->expiration > current_time_point() ) break;
 
@@ -597,14 +676,16 @@ namespace eosiosystem {
       if ( _rexorders.begin() != _rexorders.end() ) {
          auto idx  = _rexorders.get_index<"bytime"_n>();
          auto oitr = idx.begin();
-         for ( uint16_t i = 0; i < max; ++i ) {
+         for ( uint16_t i = 0; i < max && work_spent < budget; ++i ) {
             if ( oitr == idx.end() || !oitr->is_open ) break;
             auto next = oitr;
             ++next;
+            work_spent += runrex_order_work;
             auto bitr = _rexbalance.find( oitr->owner.value );
             if ( bitr != _rexbalance.end() ) { // should always be true
                auto result = fill_rex_order( bitr, oitr->rex_requested );
                if ( result.success ) {
+                  work_spent += runrex_fill_work;
                   const name order_owner = oitr->owner;
                   idx.modify( oitr, same_payer, [&]( auto& order ) {
                      order.proceeds.amount     = result.proceeds.amount;
@@ -620,8 +701,39 @@ namespace eosiosystem {
          }
       }
 
+      return work_spent;
    }
 
+   // TELOS BEGIN
+   /**
+    * @brief Counts expired CPU and NET loans and open sellrex orders, up to `runrex_backlog_max` of each
+    */
+   uint32_t system_contract::rex_backlog()const
+   {
+      const time_point now = current_time_point();
+      uint32_t backlog = 0;
+      auto count_expired = [&]( const auto& idx ) {
+         uint32_t n = 0;
+         for ( auto itr = idx.begin(); itr != idx.end() && itr->expiration <= now && n < runrex_backlog_max; ++itr ) {
+            ++n;
+         }
+         backlog += n;
+      };
+
+      rex_cpu_loan_table cpu_loans( get_self(), get_self().value );
+      count_expired( cpu_loans.get_index<"byexpr"_n>() );
+      rex_net_loan_table net_loans( get_self(), get_self().value );
+      count_expired( net_loans.get_index<"byexpr"_n>() );
+
+      const auto idx = _rexorders.get_index<"bytime"_n>();
+      uint32_t n = 0;
+      for ( auto oitr = idx.begin(); oitr != idx.end() && oitr->is_open && n < runrex_backlog_max; ++oitr ) {
+         ++n;
+      }
+      return backlog + n;
+   }
+   // TELOS END
+
    /**
     * @brief Adds returns from the REX return pool to the REX pool
     */
@@ -646,10 +758,11 @@ namespace eosiosystem {
       const uint32_t elapsed_intervals = get_elapsed_intervals( effective_time, ret_pool_elem->last_dist_time );
       int64_t        change_estimate   = current_rate * elapsed_intervals;
 
+      const bool     ring_layout       = ret_buckets_elem->version == rex_return_buckets::ring_version; // TELOS
+      const bool     new_return_bucket = ret_pool_elem->pending_bucket_time <= effective_time;
+      int64_t        new_bucket_rate   = 0;
+      time_point_sec new_bucket_time   = time_point_sec::min();
       {
-         const bool new_return_bucket = ret_pool_elem->pending_bucket_time <= effective_time;
-         int64_t        new_bucket_rate = 0;
-         time_point_sec new_bucket_time = time_point_sec::min();
          _rexretpool.modify( ret_pool_elem, same_payer, [&]( auto& rp ) {
             if ( new_return_bucket ) {
                int64_t remainder = rp.pending_bucket_proceeds % rex_return_pool::total_intervals;
@@ -667,7 +780,7 @@ namespace eosiosystem {
             rp.last_dist_time = effective_time;
          });
 
-         if ( new_return_bucket ) {
+         if ( new_return_bucket && !ring_layout ) {
             _rexretbuckets.modify( ret_buckets_elem, same_payer, [&]( auto& rb ) {
                auto iter = std::lower_bound(rb.return_buckets.begin(), rb.return_buckets.end(), new_bucket_time, [](const pair_time_point_sec_int64& bucket, time_point_sec first) {
                   return bucket.first < first;
@@ -682,7 +795,11 @@ namespace eosiosystem {
       }
 
       const time_point_sec time_threshold = effective_time - seconds(rex_return_pool::total_intervals * rex_return_pool::dist_interval);
-      if ( ret_pool_elem->oldest_bucket_time <= time_threshold ) {
+      if ( ring_layout ) {
+         // TELOS
+         update_rex_return_ring( new_return_bucket, pair_time_point_sec_int64{ new_bucket_time, new_bucket_rate },
+                                 effective_time, change_estimate );
+      } else if ( ret_pool_elem->oldest_bucket_time <= time_threshold ) {
          int64_t expired_rate = 0;
          int64_t surplus      = 0;
          _rexretbuckets.modify( ret_buckets_elem, same_payer, [&]( auto& rb ) {
@@ -721,17 +838,110 @@ namespace eosiosystem {
       }
 
       if ( change_estimate > 0 ) {
-         _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& pool ) {
-            pool.total_unlent.amount += change_estimate;
-            pool.total_lendable       = pool.total_unlent + pool.total_lent;
-         });
+         auto& pool = get_rex_pool();
+         pool.total_unlent.amount += change_estimate;
+         pool.total_lendable       = pool.total_unlent + pool.total_lent;
       }
    }
 
+   // TELOS BEGIN
+   /**
+    * @brief Adds a new return bucket to the ring layout of the return buckets and expires old buckets
+    *
+    * Expired buckets are removed before the new bucket is stored: ring slots are reused every 30 days, so a slot
+    * can only be taken by a bucket that expires in the same update. The totals are the same as with the sorted layout.
+    *
+    * @param new_return_bucket - whether `new_bucket` has to be added
+    * @param new_bucket - time and rate of the new bucket, its rate is already part of the current rate of increase
+    * @param effective_time - time of the distribution being processed
+    * @param change_estimate - proceeds added to the REX pool by the distribution, reduced by expired buckets surplus
+    */
+   void system_contract::update_rex_return_ring( bool new_return_bucket, const pair_time_point_sec_int64& new_bucket,
+                                                 const time_point_sec& effective_time, int64_t& change_estimate )
+   {
+      const uint32_t       window         = rex_return_pool::total_intervals * rex_return_pool::dist_interval;
+      const time_point_sec time_threshold = effective_time - seconds(window);
+      const auto ret_pool_elem    = _rexretpool.begin();
+      const auto ret_buckets_elem = _rexretbuckets.begin();
+      if ( !new_return_bucket && time_threshold < ret_pool_elem->oldest_bucket_time ) {
+         return;
+      }
+
+      int64_t        expired_rate = 0;
+      int64_t        surplus      = 0;
+      time_point_sec oldest       = time_point_sec::maximum();
+      auto expire = [&]( const pair_time_point_sec_int64& bucket ) {
+         const uint32_t overtime = get_elapsed_intervals( effective_time, bucket.first + seconds(window) );
+         surplus      += bucket.second * overtime;
+         expired_rate += bucket.second;
+      };
+
+      _rexretbuckets.modify( ret_buckets_elem, same_payer, [&]( auto& rb ) {
+         for ( auto& bucket : rb.return_buckets ) {
+            if ( bucket.first == time_point_sec() ) {
+               continue;
+            }
+            if ( bucket.first <= time_threshold ) {
+               expire( bucket );
+               bucket = pair_time_point_sec_int64{};
+            } else if ( bucket.first < oldest ) {
+               oldest = bucket.first;
+            }
+         }
+         if ( new_return_bucket ) {
+            if ( new_bucket.first <= time_threshold ) {
+               expire( new_bucket );
+            } else {
+               auto& slot = rb.return_buckets[ rex_return_buckets::ring_slot( new_bucket.first ) ];
+               check( slot.first == time_point_sec() || slot.first == new_bucket.first, "return bucket slot in use" ); // should never happen
+               slot = new_bucket;
+               if ( new_bucket.first < oldest ) {
+                  oldest = new_bucket.first;
+               }
+            }
+         }
+      });
+
+      _rexretpool.modify( ret_pool_elem, same_payer, [&]( auto& rp ) {
+         rp.oldest_bucket_time = ( oldest == time_point_sec::maximum() ) ? time_point_sec::min() : oldest;
+         if ( expired_rate > 0 ) {
+            rp.current_rate_of_increase -= expired_rate;
+         }
+         if ( surplus > 0 ) {
+            change_estimate -= surplus;
+            rp.proceeds     += surplus;
+         }
+      });
+   }
+
+   void system_contract::migretbucket()
+   {
+      require_auth( get_self() );
+
+      const auto ret_buckets_elem = _rexretbuckets.begin();
+      check( ret_buckets_elem != _rexretbuckets.end(), "rex return pool not initialized yet" );
+      check( ret_buckets_elem->version != rex_return_buckets::ring_version, "return buckets already use the ring layout" );
+
+      // expire old buckets first, the remaining ones are less than 30 days apart and fit in the ring
+      update_rex_pool();
+
+      _rexretbuckets.modify( ret_buckets_elem, same_payer, [&]( auto& rb ) {
+         std::vector<pair_time_point_sec_int64> slots( rex_return_buckets::ring_slots );
+         for ( const auto& bucket : rb.return_buckets ) {
+            auto& slot = slots[ rex_return_buckets::ring_slot( bucket.first ) ];
+            check( slot.first == time_point_sec(), "return buckets do not fit in the ring" );
+            slot = bucket;
+         }
+         rb.version        = rex_return_buckets::ring_version;
+         rb.return_buckets = std::move( slots );
+      });
+   }
+   // TELOS END
+
    template <typename T>
    int64_t system_contract::rent_rex( T& table, const name& from, const name& receiver, const asset& payment, const asset& fund )
    {
-      runrex(2);
+      runrex( user_runrex_max() );
 
       check( rex_loans_available(), "rex loans are currently not available" );
       check( payment.symbol == core_symbol() && fund.symbol == core_symbol(), "must use core token" );
@@ -739,10 +949,10 @@ namespace eosiosystem {
 
       transfer_from_fund( from, payment + fund );
 
-      const auto& pool = _rexpool.begin(); /// already checked that _rexpool.begin() != _rexpool.end() in rex_loans_available()
+      const auto& pool = get_rex_pool(); /// already checked that the REX pool exists in rex_loans_available()
 
-      int64_t rented_tokens = exchange_state::get_bancor_output( pool->total_rent.amount,
-                                                                 pool->total_unlent.amount,
+      int64_t rented_tokens = exchange_state::get_bancor_output( pool.total_rent.amount,
+                                                                 pool.total_unlent.amount,
                                                                  payment.amount );
       check( payment.amount < rented_tokens, "loan price does not favor renting" );
       add_loan_to_rex_pool( payment, rented_tokens, true );
@@ -754,7 +964,7 @@ namespace eosiosystem {
          c.balance      = fund;
          c.total_staked = asset( rented_tokens, core_symbol() );
          c.expiration   = current_time_point() + eosio::days(30);
-         c.loan_num     = pool->loan_num;
+         c.loan_num     = pool.loan_num;
       });
 
       rex_results::rentresult_action rentresult_act{ rex_account, std::vector<eosio::permission_level>{ } };
@@ -780,9 +990,9 @@ namespace eosiosystem {
     */
    rex_order_outcome system_contract::fill_rex_order( const rex_balance_table::const_iterator& bitr, const asset& rex )
    {
-      auto rexpool_itr = _rexpool.begin();
-      const int64_t S0 = rexpool_itr->total_lendable.amount;
-      const int64_t R0 = rexpool_itr->total_rex.amount;
+      auto& pool = get_rex_pool();
+      const int64_t S0 = pool.total_lendable.amount;
+      const int64_t R0 = pool.total_rex.amount;
       const int64_t p  = (uint128_t(rex.amount) * S0) / R0;
       const int64_t R1 = R0 - rex.amount;
       const int64_t S1 = S0 - p;
@@ -790,16 +1000,14 @@ namespace eosiosystem {
       asset stake_change( 0, core_symbol() );
       bool  success = false;
 
-      const int64_t unlent_lower_bound = rexpool_itr->total_lent.amount / 10;
-      const int64_t available_unlent   = rexpool_itr->total_unlent.amount - unlent_lower_bound; // available_unlent <= 0 is possible
+      const int64_t unlent_lower_bound = pool.total_lent.amount / 10;
+      const int64_t available_unlent   = pool.total_unlent.amount - unlent_lower_bound; // available_unlent <= 0 is possible
       if ( proceeds.amount <= available_unlent ) {
          const int64_t init_vote_stake_amount = bitr->vote_stake.amount;
          const int64_t current_stake_value    = ( uint128_t(bitr->rex_balance.amount) * S0 ) / R0;
-         _rexpool.modify( rexpool_itr, same_payer, [&]( auto& rt ) {
-            rt.total_rex.amount      = R1;
-            rt.total_lendable.amount = S1;
-            rt.total_unlent.amount   = rt.total_lendable.amount - rt.total_lent.amount;
-         });
+         pool.total_rex.amount      = R1;
+         pool.total_lendable.amount = S1;
+         pool.total_unlent.amount   = pool.total_lendable.amount - pool.total_lent.amount;
          _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
             rb.vote_stake.amount   = current_stake_value - proceeds.amount;
             rb.rex_balance.amount -= rex.amount;
@@ -951,9 +1159,7 @@ namespace eosiosystem {
    {
 #if CHANNEL_RAM_AND_NAMEBID_FEES_TO_REX
       if ( rex_available() ) {
-         _rexpool.modify( _rexpool.begin(), same_payer, [&]( auto& rp ) {
-            rp.namebid_proceeds.amount += highest_bid;
-         });
+         get_rex_pool().namebid_proceeds.amount += highest_bid;
       }
 #endif
    }
@@ -981,6 +1187,27 @@ namespace eosiosystem {
    void system_contract::process_rex_maturities( const rex_balance_table::const_iterator& bitr )
    {
       const time_point_sec now = current_time_point();
+      // TELOS BEGIN
+      if ( bitr->ring_layout() ) {
+         // only rewrite the row when a slot matured, once for all of them
+         const auto matured = [&]( const pair_time_point_sec_int64& slot ) {
+            return slot.first != time_point_sec() && slot.first <= now;
+         };
+         const auto first = bitr->rex_maturities.begin();
+         if ( std::none_of( first, first + rex_balance::maturity_slots, matured ) ) {
+            return;
+         }
+         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+            for ( uint32_t i = 0; i < rex_balance::maturity_slots; ++i ) {
+               if ( matured( rb.rex_maturities[i] ) ) {
+                  rb.matured_rex      += rb.rex_maturities[i].second;
+                  rb.rex_maturities[i] = pair_time_point_sec_int64{};
+               }
+            }
+         });
+         return;
+      }
+      // TELOS END
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
          while ( !rb.rex_maturities.empty() && rb.rex_maturities.front().first <= now ) {
             rb.matured_rex += rb.rex_maturities.front().second;
@@ -1002,6 +1229,17 @@ namespace eosiosystem {
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
          int64_t total  = rb.matured_rex - rex_in_sell_order.amount;
          rb.matured_rex = rex_in_sell_order.amount;
+         if ( rb.ring_layout() ) {
+            // TELOS
+            for ( uint32_t i = 0; i < rex_balance::maturity_slots; ++i ) {
+               total               += rb.rex_maturities[i].second;
+               rb.rex_maturities[i] = pair_time_point_sec_int64{};
+            }
+            if ( total > 0 ) {
+               rb.add_maturity( get_rex_maturity(), total );
+            }
+            return;
+         }
          while ( !rb.rex_maturities.empty() ) {
             total += rb.rex_maturities.front().second;
             rb.rex_maturities.erase(rb.rex_maturities.begin());
@@ -1033,7 +1271,6 @@ namespace eosiosystem {
       const int64_t rex_ratio = 10000;
       const asset   init_total_rent( 20'000'0000, core_symbol() ); /// base balance prevents renting profitably until at least a minimum number of core_symbol() is made available
       asset rex_received( 0, rex_symbol );
-      auto itr = _rexpool.begin();
       if ( !rex_system_initialized() ) {
          /// initialize REX pool
          _rexpool.emplace( get_self(), [&]( auto& rp ) {
@@ -1046,28 +1283,26 @@ namespace eosiosystem {
             rp.namebid_proceeds = asset( 0, core_symbol() );
          });
       } else if ( !rex_available() ) { /// should be a rare corner case, REX pool is initialized but empty
-         _rexpool.modify( itr, same_payer, [&]( auto& rp ) {
-            rex_received.amount      = payment.amount * rex_ratio;
-            rp.total_lendable.amount = payment.amount;
-            rp.total_lent.amount     = 0;
-            rp.total_unlent.amount   = rp.total_lendable.amount - rp.total_lent.amount;
-            rp.total_rent.amount     = init_total_rent.amount;
-            rp.total_rex.amount      = rex_received.amount;
-         });
+         auto& rp = get_rex_pool();
+         rex_received.amount      = payment.amount * rex_ratio;
+         rp.total_lendable.amount = payment.amount;
+         rp.total_lent.amount     = 0;
+         rp.total_unlent.amount   = rp.total_lendable.amount - rp.total_lent.amount;
+         rp.total_rent.amount     = init_total_rent.amount;
+         rp.total_rex.amount      = rex_received.amount;
       } else {
+         auto& rp = get_rex_pool();
          /// total_lendable > 0 if total_rex > 0 except in a rare case and due to rounding errors
-         check( itr->total_lendable.amount > 0, "lendable REX pool is empty" );
-         const int64_t S0 = itr->total_lendable.amount;
+         check( rp.total_lendable.amount > 0, "lendable REX pool is empty" );
+         const int64_t S0 = rp.total_lendable.amount;
          const int64_t S1 = S0 + payment.amount;
-         const int64_t R0 = itr->total_rex.amount;
+         const int64_t R0 = rp.total_rex.amount;
          const int64_t R1 = (uint128_t(S1) * R0) / S0;
          rex_received.amount = R1 - R0;
-         _rexpool.modify( itr, same_payer, [&]( auto& rp ) {
-            rp.total_lendable.amount = S1;
-            rp.total_rex.amount      = R1;
-            rp.total_unlent.amount   = rp.total_lendable.amount - rp.total_lent.amount;
-            check( rp.total_unlent.amount >= 0, "programmer error, this should never go negative" );
-         });
+         rp.total_lendable.amount = S1;
+         rp.total_rex.amount      = R1;
+         rp.total_unlent.amount   = rp.total_lendable.amount - rp.total_lent.amount;
+         check( rp.total_unlent.amount >= 0, "programmer error, this should never go negative" );
       }
 
       return rex_received;
@@ -1132,10 +1367,10 @@ namespace eosiosystem {
          current_rex_stake.amount = payment.amount;
       } else {
          init_rex_stake.amount = bitr->vote_stake.amount;
+         const auto& pool = get_rex_pool();
          _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
             rb.rex_balance.amount += rex_received.amount;
-            rb.vote_stake.amount   = ( uint128_t(rb.rex_balance.amount) * _rexpool.begin()->total_lendable.amount )
-                                     / _rexpool.begin()->total_rex.amount;
+            rb.vote_stake.amount   = ( uint128_t(rb.rex_balance.amount) * pool.total_lendable.amount ) / pool.total_rex.amount;
          });
          current_rex_stake.amount = bitr->vote_stake.amount;
       }
@@ -1143,12 +1378,7 @@ namespace eosiosystem {
       const int64_t rex_in_savings = read_rex_savings( bitr );
       process_rex_maturities( bitr );
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-         const time_point_sec maturity = get_rex_maturity();
-         if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == maturity ) {
-            rb.rex_maturities.back().second += rex_received.amount;
-         } else {
-            rb.rex_maturities.emplace_back( pair_time_point_sec_int64 { maturity, rex_received.amount } );
-         }
+         rb.add_maturity( get_rex_maturity(), rex_received.amount );
       });
       put_rex_savings( bitr, rex_in_savings );
       return current_rex_stake - init_rex_stake;
@@ -1167,6 +1397,10 @@ namespace eosiosystem {
     */
    int64_t system_contract::read_rex_savings( const rex_balance_table::const_iterator& bitr )
    {
+      // TELOS: the savings slot of the ring layout is read in place and overwritten by put_rex_savings
+      if ( bitr->ring_layout() ) {
+         return bitr->rex_maturities[ rex_balance::savings_slot ].second;
+      }
       int64_t rex_in_savings = 0;
       static const time_point_sec end_of_days = time_point_sec::maximum();
       if ( !bitr->rex_maturities.empty() && bitr->rex_maturities.back().first == end_of_days ) {
@@ -1186,8 +1420,18 @@ namespace eosiosystem {
     */
    void system_contract::put_rex_savings( const rex_balance_table::const_iterator& bitr, int64_t rex )
    {
-      if ( rex == 0 ) return;
       static const time_point_sec end_of_days = time_point_sec::maximum();
+      // TELOS BEGIN
+      if ( bitr->ring_layout() ) {
+         if ( bitr->rex_maturities[ rex_balance::savings_slot ].second != rex ) {
+            _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+               rb.rex_maturities[ rex_balance::savings_slot ] = pair_time_point_sec_int64{ end_of_days, rex };
+            });
+         }
+         return;
+      }
+      // TELOS END
+      if ( rex == 0 ) return;
       _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
          if ( !rb.rex_maturities.empty() && rb.rex_maturities.back().first == end_of_days ) {
             rb.rex_maturities.back().second += rex;
@@ -1204,19 +1448,7 @@ namespace eosiosystem {
     */
    void system_contract::update_rex_stake( const name& voter )
    {
-      int64_t delta_stake = 0;
-      auto bitr = _rexbalance.find( voter.value );
-      if ( bitr != _rexbalance.end() && rex_available() ) {
-         asset init_vote_stake = bitr->vote_stake;
-         asset current_vote_stake( 0, core_symbol() );
-         current_vote_stake.amount = ( uint128_t(bitr->rex_balance.amount) * _rexpool.begin()->total_lendable.amount )
-                                     / _rexpool.begin()->total_rex.amount;
-         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
-            rb.vote_stake.amount = current_vote_stake.amount;
-         });
-         delta_stake = current_vote_stake.amount - init_vote_stake.amount;
-      }
-
+      const int64_t delta_stake = refresh_rex_vote_stake( voter );
       if ( delta_stake != 0 ) {
          auto vitr = _voters.find( voter.value );
          if ( vitr != _voters.end() ) {
@@ -1227,4 +1459,32 @@ namespace eosiosystem {
       }
    }
 
+   // TELOS BEGIN
+   /**
+    * @brief Updates the vote stake of an account's REX balance to the current REX price
+    *
+    * @param voter - owner of the REX balance
+    *
+    * @return int64_t - change of the vote stake, which the caller must add to the voter's staked amount
+    */
+   int64_t system_contract::refresh_rex_vote_stake( const name& voter )
+   {
+      auto bitr = _rexbalance.find( voter.value );
+      if ( bitr == _rexbalance.end() || !rex_available() ) {
+         return 0;
+      }
+
+      const int64_t init_vote_stake = bitr->vote_stake.amount;
+      const auto&   pool               = get_rex_pool();
+      const int64_t current_vote_stake = ( uint128_t(bitr->rex_balance.amount) * pool.total_lendable.amount )
+                                         / pool.total_rex.amount;
+      if ( current_vote_stake != init_vote_stake ) {
+         _rexbalance.modify( bitr, same_payer, [&]( auto& rb ) {
+            rb.vote_stake.amount = current_vote_stake;
+         });
+      }
+      return current_vote_stake - init_vote_stake;
+   }
+   // TELOS END
+
 }; /// namespace eosiosystem
\ No newline at end of file
@@ -8,4 +8,6 @@ void rex_results::orderresult( const name& owner, const asset& proceeds ) { }
 
 void rex_results::rentresult( const asset& rented_tokens ) { }
 
+void rex_results::execresult( uint32_t work_spent, uint32_t backlog ) { }
+
 extern "C" void apply( uint64_t, uint64_t, uint64_t ) { }
@@ -10,7 +10,8 @@ namespace eosiosystem {
   bool system_contract::crossed_missed_blocks_threshold(uint32_t amountBlocksMissed, uint32_t schedule_size) {
     if (schedule_size <= 1) return false;
 
-    auto timeframe = (_grotation.next_rotation_time.to_time_point() - _grotation.last_rotation_time.to_time_point()).to_seconds();
+    const auto &rotation = get_rotation();
+    auto timeframe = (rotation.next_rotation_time.to_time_point() - rotation.last_rotation_time.to_time_point()).to_seconds();
     // Total blocks that can be produced in a cycle
     auto maxBlocksPerCycle = (schedule_size - 1) * MAX_BLOCK_PER_CYCLE;
     // total block that can be produced in the current timeframe
@@ -24,38 +25,40 @@ namespace eosiosystem {
   }
 
   void system_contract::reset_schedule_metrics(name producer = name(0)) {
-    for (auto &pm : _gschedule_metrics.producers_metric) {
+    for (auto &pm : get_schedule_metrics().producers_metric) {
       if (producer != name(0) && pm.bp_name == producer) pm.missed_blocks_per_cycle = MAX_BLOCK_PER_CYCLE - 1;
       else pm.missed_blocks_per_cycle = MAX_BLOCK_PER_CYCLE;
     }
   }
 
-  void system_contract::update_producer_missed_blocks(name producer) {
-    for (auto &pm : _gschedule_metrics.producers_metric) {
-      if (pm.bp_name == producer && pm.missed_blocks_per_cycle > 0) {
-        pm.missed_blocks_per_cycle--;
-        break;
-      }
-    }
-  }
+  /*
+  * producers_metric is kept in schedule order, so once the proposed schedule is active the producer of a block
+  * sits at the position its slot maps to. The name is still verified and a linear scan is the fallback for the
+  * blocks around a schedule change.
+  */
+  producer_metric* system_contract::find_producer_metric(block_timestamp timestamp, name producer) {
+    auto &metrics = get_schedule_metrics().producers_metric;
+    if (metrics.empty()) return nullptr;
 
-  bool system_contract::is_new_schedule_activated(name active_schedule[], uint32_t size) {
-    std::vector<name> new_schedule;
-    for (auto &p : _gschedule_metrics.producers_metric) new_schedule.emplace_back(p.bp_name);
-
-    std::sort(new_schedule.begin(), new_schedule.end());
-    std::sort(active_schedule, active_schedule + size);
+    const uint32_t index = (timestamp.slot % (uint32_t(metrics.size()) * MAX_BLOCK_PER_CYCLE)) / MAX_BLOCK_PER_CYCLE;
+    if (metrics[index].bp_name == producer) return &metrics[index];
 
-    for (size_t i = 0; i < size; i++){
-      if (active_schedule[i] != new_schedule[i]) return false;
+    for (auto &pm : metrics) {
+      if (pm.bp_name == producer) return &pm;
     }
+    return nullptr;
+  }
 
-    return true;
+  void system_contract::update_producer_missed_blocks(block_timestamp timestamp, name producer) {
+    auto pm = find_producer_metric(timestamp, producer);
+    if (pm != nullptr && pm->missed_blocks_per_cycle > 0) {
+      pm->missed_blocks_per_cycle--;
+    }
   }
 
   bool system_contract::is_new_schedule_activated(std::vector<name>& active_schedule) {
     std::vector<name> new_schedule;
-    for (auto &p : _gschedule_metrics.producers_metric) new_schedule.emplace_back(p.bp_name);
+    for (auto &p : get_schedule_metrics().producers_metric) new_schedule.emplace_back(p.bp_name);
 
     std::sort(new_schedule.begin(), new_schedule.end());
     std::sort(active_schedule.begin(), active_schedule.end());
@@ -67,69 +70,93 @@ namespace eosiosystem {
     return true;
   }
 
+  bool system_contract::is_proposed_schedule_active() {
+    auto active_schedule = get_active_producers();
+    const uint32_t size = active_schedule.size();
+
+    if (_gstate.last_producer_schedule_size != size) return false;
+
+    schedule_fingerprint active;
+    for (const auto &p : active_schedule) active.add(p);
+
+    auto &metrics = get_schedule_metrics();
+    if (metrics.activation_cache.has_value() && metrics.activation_cache->active == active) {
+      return metrics.activation_cache->activated;
+    }
+
+    schedule_activation_cache cache;
+    if (metrics.activation_cache.has_value()) {
+      cache.proposed = metrics.activation_cache->proposed;
+    } else {
+      for (auto &pm : metrics.producers_metric) cache.proposed.add(pm.bp_name);
+    }
+    cache.active = active;
+    // different fingerprints rule out a match, equal ones are confirmed by the full comparison
+    cache.activated = cache.proposed == active && metrics.producers_metric.size() == size && is_new_schedule_activated(active_schedule);
+    metrics.activation_cache.emplace(cache);
+
+    return cache.activated;
+  }
+
   bool system_contract::check_missed_blocks(block_timestamp timestamp, name producer) {
+    auto &metrics = get_schedule_metrics();
+
     if (producer == "eosio"_n) {
-      _gschedule_metrics.block_counter_correction++;
-      _gschedule_metrics.last_onblock_caller = producer;
+      metrics.block_counter_correction++;
+      metrics.last_onblock_caller = producer;
       return false;
     }
 
-    auto producers_schedule = get_active_producers();
-    bool is_activated = _gstate.last_producer_schedule_size == producers_schedule.size() && is_new_schedule_activated(producers_schedule);
+    bool is_activated = is_proposed_schedule_active();
 
     if (!is_activated) {
-      if (_gschedule_metrics.last_onblock_caller != producer) _gschedule_metrics.block_counter_correction = 1;
-      else _gschedule_metrics.block_counter_correction++;
+      if (metrics.last_onblock_caller != producer) metrics.block_counter_correction = 1;
+      else metrics.block_counter_correction++;
 
-      _gschedule_metrics.last_onblock_caller = producer;
+      metrics.last_onblock_caller = producer;
       return false;
-    } else if (_gschedule_metrics.block_counter_correction > 0) {
-      if (_gschedule_metrics.last_onblock_caller == "eosio"_n) {
-        for (auto &pm : _gschedule_metrics.producers_metric) {
-          if (pm.bp_name == producer) {
-            pm.missed_blocks_per_cycle -= uint32_t(_gschedule_metrics.block_counter_correction);
-            break;
-          }
+    } else if (metrics.block_counter_correction > 0) {
+      if (metrics.last_onblock_caller == "eosio"_n) {
+        auto pm = find_producer_metric(timestamp, producer);
+        if (pm != nullptr) {
+          pm->missed_blocks_per_cycle -= uint32_t(metrics.block_counter_correction);
         }
       } else {
           reset_schedule_metrics();
-          _gschedule_metrics.block_counter_correction = -3;
+          metrics.block_counter_correction = -3;
       }
-      _gschedule_metrics.last_onblock_caller = producer;
+      metrics.last_onblock_caller = producer;
     }
 
-    if (_gschedule_metrics.block_counter_correction < 0) {
-      if (_gschedule_metrics.last_onblock_caller != producer && _gschedule_metrics.block_counter_correction < 0) {
-        _gschedule_metrics.block_counter_correction++;
+    if (metrics.block_counter_correction < 0) {
+      if (metrics.last_onblock_caller != producer && metrics.block_counter_correction < 0) {
+        metrics.block_counter_correction++;
       }
 
-      _gschedule_metrics.last_onblock_caller = producer;
-      if (_gschedule_metrics.block_counter_correction < 0) {
+      metrics.last_onblock_caller = producer;
+      if (metrics.block_counter_correction < 0) {
         return false;
       }
     }
 
     auto pitr = _producers.find(producer.value);
+    ONBLOCK_ROWS_READ(1);
     if (pitr != _producers.end() && !pitr->is_active) {
       reset_schedule_metrics();
       update_elected_producers(timestamp);
       return false;
     }
 
-    if (_gschedule_metrics.last_onblock_caller != producer) {
-      for (auto &pm : _gschedule_metrics.producers_metric) {
-        if (pm.bp_name == producer) {                       
-          if (pm.missed_blocks_per_cycle != MAX_BLOCK_PER_CYCLE) {        
-            _gschedule_metrics.last_onblock_caller = producer;
-            return true;
-          }
-          break;
-        }
+    if (metrics.last_onblock_caller != producer) {
+      auto pm = find_producer_metric(timestamp, producer);
+      if (pm != nullptr && pm->missed_blocks_per_cycle != MAX_BLOCK_PER_CYCLE) {
+        metrics.last_onblock_caller = producer;
+        return true;
       }
     }
     
-    update_producer_missed_blocks(producer);
-    _gschedule_metrics.last_onblock_caller = producer;
+    update_producer_missed_blocks(timestamp, producer);
+    metrics.last_onblock_caller = producer;
 
     return false;
   }
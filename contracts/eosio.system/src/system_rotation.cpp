@@ -13,28 +13,33 @@ namespace eosiosystem {
 using namespace eosio;
 
 void system_contract::set_bps_rotation(name bpOut, name sbpIn) {
-  _grotation.bp_currently_out = bpOut;
-  _grotation.sbp_currently_in = sbpIn;
+  auto &rotation = get_rotation();
+  rotation.bp_currently_out = bpOut;
+  rotation.sbp_currently_in = sbpIn;
 }
 
 void system_contract::update_rotation_time(block_timestamp block_time) {
-  _grotation.last_rotation_time = block_time;
-  _grotation.next_rotation_time = block_timestamp(
+  auto &rotation = get_rotation();
+  rotation.last_rotation_time = block_time;
+  rotation.next_rotation_time = block_timestamp(
       block_time.to_time_point() + time_point(microseconds(TWELVE_HOURS_US)));
 }
 
 void system_contract::update_missed_blocks_per_rotation() {
+  auto &metrics = get_schedule_metrics();
   auto active_schedule_size =
-      std::distance(_gschedule_metrics.producers_metric.begin(),
-                    _gschedule_metrics.producers_metric.end());
+      std::distance(metrics.producers_metric.begin(),
+                    metrics.producers_metric.end());
   uint16_t max_kick_bps = uint16_t(active_schedule_size / 7);
 
   std::vector<producer_info> prods;
 
-  for (auto &pm : _gschedule_metrics.producers_metric) {
+  for (auto &pm : metrics.producers_metric) {
     auto pitr = _producers.find(pm.bp_name.value);
+    ONBLOCK_ROWS_READ(1);
     if (pitr != _producers.end() && pitr->is_active) {
       if (pm.missed_blocks_per_cycle > 0) {
+        ONBLOCK_ROWS_WRITTEN(1);
         //  print("\nblock producer: ", name{pm.name}, " missed ",
         //  pm.missed_blocks_per_cycle, " blocks.");
         _producers.modify(pitr, same_payer, [&](auto &p) {
@@ -62,10 +67,12 @@ void system_contract::update_missed_blocks_per_rotation() {
     if (crossed_missed_blocks_threshold(pitr->missed_blocks_per_rotation,
                                         uint32_t(active_schedule_size)) &&
         max_kick_bps > 0) {
+      on_producer_deactivate(*pitr);
       _producers.modify(pitr, same_payer, [&](auto &p) {
         p.lifetime_missed_blocks += p.missed_blocks_per_rotation;
         p.kick(kick_type::REACHED_TRESHOLD);
       });
+      ONBLOCK_ROWS_WRITTEN(1);
       max_kick_bps--;
     } else
       break;
@@ -78,8 +85,10 @@ void system_contract::restart_missed_blocks_per_rotation(
   for (size_t i = 0; i < prods.size(); i++) {
     auto bp_name = prods[i].first.producer_name;
     auto pitr = _producers.find(bp_name.value);
+    ONBLOCK_ROWS_READ(1);
 
     if (pitr != _producers.end()) {
+      ONBLOCK_ROWS_WRITTEN(1);
       _producers.modify(pitr, same_payer, [&](auto &p) {
         if (p.times_kicked > 0 && p.missed_blocks_per_rotation == 0) {
           p.times_kicked--;
@@ -96,21 +105,22 @@ void system_contract::restart_missed_blocks_per_rotation(
    } 
 
 std::vector<producer_location_pair> system_contract::check_rotation_state( std::vector<producer_location_pair> prods, block_timestamp block_time) {
+      auto &rotation = get_rotation();
       uint32_t total_active_voted_prods = prods.size(); 
       std::vector<producer_location_pair>::iterator it_bp = prods.end();
       std::vector<producer_location_pair>::iterator it_sbp = prods.end();
 
-      if (_grotation.next_rotation_time <= block_time) {
+      if (rotation.next_rotation_time <= block_time) {
 
         if (total_active_voted_prods > TOP_PRODUCERS) {
-          _grotation.bp_out_index = _grotation.bp_out_index >= TOP_PRODUCERS - 1 ? 0 : _grotation.bp_out_index + 1;
-          _grotation.sbp_in_index = _grotation.sbp_in_index >= total_active_voted_prods - 1 ? TOP_PRODUCERS : _grotation.sbp_in_index + 1;
+          rotation.bp_out_index = rotation.bp_out_index >= TOP_PRODUCERS - 1 ? 0 : rotation.bp_out_index + 1;
+          rotation.sbp_in_index = rotation.sbp_in_index >= total_active_voted_prods - 1 ? TOP_PRODUCERS : rotation.sbp_in_index + 1;
 
-          name bp_name = prods[_grotation.bp_out_index].first.producer_name;
-          name sbp_name = prods[_grotation.sbp_in_index].first.producer_name;
+          name bp_name = prods[rotation.bp_out_index].first.producer_name;
+          name sbp_name = prods[rotation.sbp_in_index].first.producer_name;
 
-          it_bp = prods.begin() + int32_t(_grotation.bp_out_index);
-          it_sbp = prods.begin() + int32_t(_grotation.sbp_in_index);
+          it_bp = prods.begin() + int32_t(rotation.bp_out_index);
+          it_sbp = prods.begin() + int32_t(rotation.sbp_in_index);
 
           set_bps_rotation(bp_name, sbp_name);
         } 
@@ -119,13 +129,13 @@ std::vector<producer_location_pair> system_contract::check_rotation_state( std::
         restart_missed_blocks_per_rotation(prods);
       }
       else {
-        if(_grotation.bp_currently_out != name(0) && _grotation.sbp_currently_in != name(0)) {
-          auto bp_name = _grotation.bp_currently_out;
+        if(rotation.bp_currently_out != name(0) && rotation.sbp_currently_in != name(0)) {
+          auto bp_name = rotation.bp_currently_out;
           it_bp = std::find_if(prods.begin(), prods.end(), [&bp_name](const producer_location_pair &g) {
             return g.first.producer_name == bp_name; 
           });
 
-          auto sbp_name = _grotation.sbp_currently_in;
+          auto sbp_name = rotation.sbp_currently_in;
           it_sbp = std::find_if(prods.begin(), prods.end(), [&sbp_name](const producer_location_pair &g) {
             return g.first.producer_name == sbp_name; 
           });
@@ -136,8 +146,8 @@ std::vector<producer_location_pair> system_contract::check_rotation_state( std::
               set_bps_rotation(name(0), name(0));
 
             if(total_active_voted_prods < TOP_PRODUCERS) {
-              _grotation.bp_out_index = TOP_PRODUCERS;
-              _grotation.sbp_in_index = MAX_PRODUCERS+1;
+              rotation.bp_out_index = TOP_PRODUCERS;
+              rotation.sbp_in_index = MAX_PRODUCERS+1;
             }
           } else if (total_active_voted_prods > TOP_PRODUCERS && 
                     (!is_in_range(_bp_index, 0, TOP_PRODUCERS) || !is_in_range(_sbp_index, TOP_PRODUCERS, MAX_PRODUCERS))) {
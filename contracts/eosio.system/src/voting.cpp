@@ -12,12 +12,12 @@
 
 #include <type_traits>
 #include <limits>
+#include <map>
 #include <set>
 #include <algorithm>
 #include <cmath>
 
 // TELOS BEGIN
-#include <boost/container/flat_map.hpp>
 #include "system_rotation.cpp"
 // TELOS END
 
@@ -42,7 +42,15 @@ namespace eosiosystem {
          }
       }, producer_authority );
 
+      assign_producer_id( producer, producer ); // TELOS
+
       if ( prod != _producers.end() ) {
+         // TELOS BEGIN
+         if ( !prod->active() ) {
+            get_election_state().active_producers++;
+         }
+         get_election_state().vote_epoch++; // key, authority or location may have changed
+         // TELOS END
          _producers.modify( prod, producer, [&]( producer_info& info ){
             info.producer_key       = producer_key;
             info.is_active          = true;
@@ -63,6 +71,10 @@ namespace eosiosystem {
             // When introducing the producer2 table row for the first time, the producer's votes must also be accounted for in the global total_producer_votepay_share at the same time.
          }
       } else {
+         // TELOS BEGIN
+         get_election_state().active_producers++;
+         get_election_state().vote_epoch++;
+         // TELOS END
          _producers.emplace( producer, [&]( producer_info& info ){
             info.owner              = producer;
             info.total_votes        = 0;
@@ -77,6 +89,25 @@ namespace eosiosystem {
             info.owner                     = producer;
             info.last_votepay_share_update = ct;
          });
+
+         // TELOS BEGIN
+         producer_stats_table stats( get_self(), get_self().value );
+         stats.emplace( producer, [&]( producer_stats& s ){
+            s.owner = producer;
+         });
+
+         // a producer registered while votes are being recalculated needs a tally row,
+         // otherwise the votes it receives from voters not yet tallied would be dropped
+         vote_recalc_singleton recalc_sing( get_self(), get_self().value );
+         if( recalc_sing.exists() && recalc_sing.get().phase != static_cast<uint8_t>(recalc_phase::apply) ) {
+            vote_tally_table tally( get_self(), get_self().value );
+            if( tally.find( producer.value ) == tally.end() ) {
+               tally.emplace( get_self(), [&]( auto& t ) {
+                  t.owner = producer;
+               });
+            }
+         }
+         // TELOS END
       }
 
    }
@@ -103,6 +134,7 @@ namespace eosiosystem {
       require_auth( producer );
 
       const auto& prod = _producers.get( producer.value, "producer not found" );
+      on_producer_deactivate( prod ); // TELOS
       _producers.modify( prod, same_payer, [&]( producer_info& info ){
          info.deactivate();
       });
@@ -114,26 +146,54 @@ namespace eosiosystem {
       require_auth( producer );
 
       const auto& prod = _producers.get( producer.value, "producer not found" );
+      on_producer_deactivate( prod );
       _producers.modify( prod, same_payer, [&]( producer_info& info ){
          info.deactivate();
          info.unreg_reason = reason;
       });
    }
+
+   // Keeps the active producer count of the election state in sync, must be called before `prod` is deactivated
+   void system_contract::on_producer_deactivate( const producer_info& prod ) {
+      auto& election = get_election_state();
+      if( prod.active() && election.active_producers > 0 ) {
+         election.active_producers--;
+      }
+      election.vote_epoch++;
+   }
    // TELOS END
 
    void system_contract::update_elected_producers( const block_timestamp& block_time ) {
       _gstate.last_producer_schedule_update = block_time;
 
+      // TELOS BEGIN
+      // nothing that affects the ranking happened since the last pass and no rotation is due
+      auto& election = get_election_state();
+      if( election.last_elected_epoch == election.vote_epoch && block_time < get_rotation().next_rotation_time ) {
+         return;
+      }
+      election.last_elected_epoch = election.vote_epoch;
+      // TELOS END
+
       auto idx = _producers.get_index<"prototalvote"_n>();
 
       // TELOS BEGIN
-      uint32_t totalActiveVotedProds = uint32_t(std::distance(idx.begin(), idx.end()));
+      // active producers sort ahead of inactive ones, so the walk below never reads more than MAX_PRODUCERS rows;
+      // the walk also stops at the first inactive producer when the count is not seeded yet
+      uint32_t totalActiveVotedProds = _gelection_seeded ? election.active_producers : MAX_PRODUCERS;
       totalActiveVotedProds = totalActiveVotedProds > MAX_PRODUCERS ? MAX_PRODUCERS : totalActiveVotedProds;
+      if( totalActiveVotedProds == 0 ) {
+         election.last_elected_cutoff = 0;
+         return;
+      }
 
       std::vector< producer_location_pair > active_producers, top_producers;
       active_producers.reserve(totalActiveVotedProds);
 
+      double lowest_votes = 0;
       for( auto it = idx.cbegin(); it != idx.cend() && active_producers.size() < totalActiveVotedProds /*TELOS*/ && 0 < it->total_votes && it->active(); ++it ) {
+         ONBLOCK_ROWS_READ( 1 );
+         lowest_votes = it->total_votes;
          active_producers.emplace_back(
             eosio::producer_authority{
                .producer_name = it->owner,
@@ -143,6 +203,9 @@ namespace eosiosystem {
          );
       }
 
+      // producers below the cutoff can only change the ranking by rising to it, see affects_ranking
+      election.last_elected_cutoff = active_producers.size() == MAX_PRODUCERS ? lowest_votes : 0;
+
       if( active_producers.size() == 0 || active_producers.size() < _gstate.last_producer_schedule_size ) {
          return;
       }
@@ -162,13 +225,24 @@ namespace eosiosystem {
          producers.push_back( std::move(item.first) );
 
       // TELOS BEGIN
+      // the same schedule (names, authorities and order) was already proposed
+      const auto packed_schedule = eosio::pack(producers);
+      const auto schedule_digest = eosio::sha256(packed_schedule.data(), packed_schedule.size());
+      if (schedule_digest == election.last_schedule_digest) {
+        return;
+      }
+
       auto schedule_version = set_proposed_producers(producers);
-      if (schedule_version >= 0) {
+      if (schedule_version < 0) {
+        // not proposed, e.g. another proposed schedule is still pending: make the next pass try again
+        election.last_elected_epoch = election.vote_epoch - 1;
+      } else {
+        election.last_schedule_digest = schedule_digest;
         print("\n**new schedule was proposed**");
 
         _gstate.last_proposed_schedule_update = block_time;
 
-        _gschedule_metrics.producers_metric.erase( _gschedule_metrics.producers_metric.begin(), _gschedule_metrics.producers_metric.end());
+        auto &metrics = get_schedule_metrics();
 
         std::vector<producer_metric> psm;
         std::for_each(top_producers.begin(), top_producers.end(), [&psm](auto &tp) {
@@ -176,7 +250,11 @@ namespace eosiosystem {
           psm.emplace_back(producer_metric{ bp_name, 12 });
         });
 
-        _gschedule_metrics.producers_metric = psm;
+        metrics.producers_metric = psm;
+
+        schedule_activation_cache activation_cache;
+        for (auto &pm : psm) activation_cache.proposed.add(pm.bp_name);
+        metrics.activation_cache.emplace(activation_cache); // activation is re-checked on the next block
 
         _gstate.last_producer_schedule_size = static_cast<decltype(_gstate.last_producer_schedule_size)>(top_producers.size());
       }
@@ -194,11 +272,29 @@ namespace eosiosystem {
    * This function caculates the inverse weight voting. 
    * The maximum weighted vote will be reached if an account votes for the maximum number of registered producers (up to 30 in total).  
    */
+   /*
+   * With fixed point votes enabled the curve is read from a table instead: entry n is (1 - cos(pi * n / 30)) / 2,
+   * which equals the sin() form above, scaled by 2^32. The weight is then always a whole number of stake units,
+   * small enough to be represented exactly by a double, so sums of weights never drift.
+   */
+   static constexpr uint64_t fixed_vote_weights[MAX_VOTE_PRODUCERS + 1] = {
+      0,          11764140,   46927670,   105105331,  185659716,  287708255,  410132882,  551592287,
+      710536612,  885224430,  1073741824, 1274023358, 1483874706, 1700996692, 1923010482, 2147483648,
+      2371956814, 2593970604, 2811092590, 3020943938, 3221225472, 3409742866, 3584430684, 3743375009,
+      3884834414, 4007259041, 4109307580, 4189861965, 4248039626, 4283203156, 4294967296
+   };
+
    double system_contract::inverse_vote_weight(double staked, double amountVotedProducers) {
      if (amountVotedProducers == 0.0) {
        return 0;
      }
 
+     if (fixed_point_votes()) {
+       const uint32_t voted = std::min<uint32_t>(uint32_t(amountVotedProducers), MAX_VOTE_PRODUCERS);
+       const uint128_t weight = (uint128_t(uint64_t(staked)) * fixed_vote_weights[voted]) >> 32;
+       return double(uint64_t(weight));
+     }
+
      double percentVoted = amountVotedProducers / MAX_VOTE_PRODUCERS;
      double voteWeight = (sin(M_PI * percentVoted - M_PI_2) + 1.0) / 2.0;
      return (voteWeight * staked);
@@ -291,13 +387,7 @@ namespace eosiosystem {
       if( rex_itr != _rexbalance.end() && rex_itr->rex_balance.amount > 0 ) {
          new_staked += rex_itr->vote_stake.amount;
       }
-      del_bandwidth_table     del_tbl( get_self(), voter_name.value );
-
-      auto del_itr = del_tbl.begin();
-      while(del_itr != del_tbl.end()) {
-         new_staked += del_itr->net_weight.amount + del_itr->cpu_weight.amount;
-         del_itr++;
-      }
+      new_staked += get_delegated_out( *voter );
 
       if( voter->staked != new_staked){
          // check if staked and new_staked are different and only
@@ -306,11 +396,102 @@ namespace eosiosystem {
          });
       }
 
-      update_votes(voter_name, voter->proxy, voter->producers, true);
+      update_votes(voter_name, voter->proxy, get_voter_producers(*voter), true);
    } // voteupdate
 
 
-   void system_contract::update_votes( const name& voter_name, const name& proxy, const std::vector<name>& producers, bool voting ) {
+   // TELOS BEGIN
+   void system_contract::voteupdbatch( uint16_t max ) {
+      check( max > 0, "max must be positive" );
+
+      vote_update_singleton batch_sing( get_self(), get_self().value );
+      auto batch = batch_sing.get_or_default();
+
+      vote_recalc_singleton recalc_sing( get_self(), get_self().value );
+      const bool recalc_running = recalc_sing.exists();
+      auto recalc = recalc_sing.get_or_default();
+
+      // summed vote changes of direct voters, written once per producer after the batch
+      std::map<name, double> producer_deltas;
+
+      name last_voter;
+      auto vitr = _voters.upper_bound( batch.cursor.value );
+      for( uint16_t processed = 0; vitr != _voters.end() && processed < max; ++vitr, ++processed ) {
+         const auto& voter = *vitr;
+         last_voter = voter.owner;
+
+         int64_t new_staked = get_delegated_out( voter );
+         refresh_rex_vote_stake( voter.owner );
+         auto bitr = _rexbalance.find( voter.owner.value );
+         if( bitr != _rexbalance.end() ) {
+            new_staked += bitr->vote_stake.amount;
+         }
+
+         if( voter.proxy || voter.producer_count() == 0 ) {
+            if( voter.staked != new_staked ) {
+               _voters.modify( vitr, same_payer, [&]( auto& v ) {
+                  v.staked = new_staked;
+               });
+               // proxied votes go through the proxy chain
+               if( voter.proxy ) {
+                  update_votes( voter.owner, voter.proxy, std::vector<name>(), false );
+               }
+            }
+            continue;
+         }
+
+         int64_t total_staked = new_staked;
+         if( voter.is_proxy ) {
+            total_staked += voter.proxied_vote_weight;
+         }
+
+         const auto producers  = get_voter_producers( voter );
+         const double new_weight = inverse_vote_weight( (double)total_staked, (double)producers.size() );
+         const double delta      = new_weight - voter.last_vote_weight;
+         const int64_t activated = total_staked - voter.last_stake;
+         if( voter.staked == new_staked && delta == 0 && activated == 0 ) {
+            continue;
+         }
+
+         _gstate.total_activated_stake += activated;
+         if( delta != 0 ) {
+            for( const auto& p : producers ) {
+               producer_deltas[p] += delta;
+            }
+         }
+         if( recalc_running && recalc.is_tallied( voter.owner ) ) {
+            if( delta != 0 ) {
+               for( const auto& p : producers ) {
+                  apply_recalc_vote_delta( recalc, p, delta );
+               }
+            }
+            recalc.total_activated_stake += activated;
+         }
+
+         _voters.modify( vitr, same_payer, [&]( auto& v ) {
+            v.staked           = new_staked;
+            v.last_stake       = total_staked;
+            v.last_vote_weight = new_weight;
+         });
+      }
+      batch.cursor = ( vitr == _voters.end() ) ? name() : last_voter;
+      batch_sing.set( batch, get_self() );
+
+      for( const auto& pd : producer_deltas ) {
+         if( pd.second == 0 ) {
+            continue;
+         }
+         add_producer_votes( _producers.get( pd.first.value, "producer not found" ), pd.second ); // data corruption
+      }
+
+      if( recalc_running ) {
+         recalc_sing.set( recalc, get_self() );
+      }
+   }
+   // TELOS END
+
+   void system_contract::update_votes( const name& voter_name, const name& proxy, const std::vector<name>& producers, bool voting,
+                                       const voter_stake_delta& pending ) {
       //validate input
       if ( proxy ) {
          check( producers.size() == 0, "cannot vote for producers and proxy at same time" );
@@ -327,7 +508,10 @@ namespace eosiosystem {
       check( !proxy || !voter->is_proxy, "account registered as a proxy is not allowed to use a proxy" );
 
       // TELOS BEGIN
-      auto totalStaked = voter->staked;
+      const int64_t init_activated_stake = _gstate.total_activated_stake;
+
+      const int64_t staked = voter->staked + pending.staked; // pending changes are written with the new vote below
+      auto totalStaked = staked;
       if(voter->is_proxy){
          totalStaked += voter->proxied_vote_weight;
       }
@@ -346,7 +530,12 @@ namespace eosiosystem {
       }
 
       auto new_vote_weight = inverse_vote_weight((double)totalStaked, (double) producers.size());
-      boost::container::flat_map<name, std::pair< double, bool > > producer_deltas;
+      std::vector<name> old_producers;
+
+      // votes are stored as producer ids once every producer has one
+      std::vector<uint16_t> producer_ids;
+      const bool compact = compact_votes() >= static_cast<uint8_t>(compact_votes_stage::voters) &&
+                           to_producer_ids( producers, producer_ids );
 
       // print("\n Voter : ", voter->last_stake, " = ", voter->last_vote_weight, " = ", proxy, " = ", producers.size(), " = ", totalStaked, " = ", new_vote_weight);
 
@@ -367,12 +556,10 @@ namespace eosiosystem {
                _gstate.total_activated_stake += totalStaked - voter->last_stake;
                propagate_weight_change( *old_proxy );
             }
+         } else if( compact ) {
+            old_producers = get_voter_producers( *voter, producers, producer_ids );
          } else {
-            for( const auto& p : voter->producers ) {
-               auto& d = producer_deltas[p];
-               d.first -= voter->last_vote_weight;
-               d.second = false;
-            }
+            old_producers = get_voter_producers( *voter );
          }
       }
 
@@ -382,50 +569,81 @@ namespace eosiosystem {
          check( !voting || new_proxy->is_proxy, "proxy not found" );
 
          _voters.modify( new_proxy, same_payer, [&]( auto& vp ) {
-            vp.proxied_vote_weight += voter->staked;
+            vp.proxied_vote_weight += staked;
          });
 
          if((*new_proxy).last_vote_weight > 0){
             _gstate.total_activated_stake += totalStaked - voter->last_stake;
             propagate_weight_change( *new_proxy );
          }
-      } else {
-         if( new_vote_weight >= 0 ) {
-            for( const auto& p : producers ) {
-               auto& d = producer_deltas[p]; 
-               d.first += new_vote_weight;
-               d.second = true;
-            }
+      }
+
+      // both vote lists are sorted, merge them into one net delta per producer
+      struct producer_delta {
+         name     producer;
+         double   delta;
+         bool     from_new; // producer is part of the new vote
+      };
+      const size_t new_count = ( !proxy && new_vote_weight >= 0 ) ? producers.size() : 0;
+      std::vector<producer_delta> producer_deltas;
+      producer_deltas.reserve( old_producers.size() + new_count );
+      for( size_t i = 0, j = 0; i < old_producers.size() || j < new_count; ) {
+         if( j == new_count || ( i < old_producers.size() && old_producers[i] < producers[j] ) ) {
+            producer_deltas.push_back( { old_producers[i++], -voter->last_vote_weight, false } );
+         } else if( i == old_producers.size() || producers[j] < old_producers[i] ) {
+            producer_deltas.push_back( { producers[j++], new_vote_weight, true } );
+         } else {
+            producer_deltas.push_back( { producers[j++], new_vote_weight - voter->last_vote_weight, true } );
+            ++i;
          }
       }
 
       for( const auto& pd : producer_deltas ) {
-         auto pitr = _producers.find( pd.first.value );
+         auto pitr = _producers.find( pd.producer.value );
          if( pitr != _producers.end() ) {
-            if( voting && !pitr->active() && pd.second.second /* from new set */ ) {
+            if( voting && !pitr->active() && pd.from_new ) {
                check( false, ( "producer " + pitr->owner.to_string() + " is not currently registered" ).data() );
             }
-            _producers.modify( pitr, same_payer, [&]( auto& p ) {
-               p.total_votes += pd.second.first;
-               if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
-                  p.total_votes = 0;
-               }
-               _gstate.total_producer_vote_weight += pd.second.first;
-               //check( p.total_votes >= 0, "something bad happened" );
-            });
+            // kept the producer and the weight did not change, leave the row alone
+            if( pd.delta == 0 ) {
+               continue;
+            }
+            add_producer_votes( *pitr, pd.delta );
          } else {
-            if( pd.second.second ) {
-               check( false, ( "producer " + pd.first.to_string() + " is not registered" ).data() );
+            if( pd.from_new ) {
+               check( false, ( "producer " + pd.producer.to_string() + " is not registered" ).data() );
             }
          }
       }
 
       _voters.modify( voter, same_payer, [&]( auto& av ) {
+         apply_voter_stake_delta( av, pending );
          av.last_vote_weight = new_vote_weight;
          av.last_stake = int64_t(totalStaked);
-         av.producers = producers;
+         if( compact ) {
+            av.producers.clear();
+            av.producer_ids.emplace( std::move(producer_ids) );
+         } else {
+            av.producers = producers;
+            av.producer_ids.reset();
+         }
          av.proxy     = proxy;
       });
+
+      // keep an in-flight recalculation consistent with votes cast by voters it already counted
+      vote_recalc_singleton recalc_sing( get_self(), get_self().value );
+      if( recalc_sing.exists() ) {
+         auto recalc = recalc_sing.get();
+         if( recalc.is_tallied( voter_name ) ) {
+            for( const auto& pd : producer_deltas ) {
+               if( pd.delta != 0 && _producers.find( pd.producer.value ) != _producers.end() ) {
+                  apply_recalc_vote_delta( recalc, pd.producer, pd.delta );
+               }
+            }
+            recalc.total_activated_stake += _gstate.total_activated_stake - init_activated_stake;
+            recalc_sing.set( recalc, get_self() );
+         }
+      }
       // TELOS END
    }
 
@@ -444,7 +662,7 @@ namespace eosiosystem {
             });
          // TELOS BEGIN
          // propagate_weight_change( *pitr );
-         update_votes(pitr->owner, pitr->proxy, pitr->producers, true);
+         update_votes(pitr->owner, pitr->proxy, get_voter_producers(*pitr), true);
          // TELOS END
       } else {
          _voters.emplace( proxy, [&]( auto& p ) {
@@ -477,7 +695,7 @@ namespace eosiosystem {
             const auto ct = current_time_point();
             double delta_change_rate         = 0;
             double total_inactive_vpay_share = 0;
-            for ( auto acnt : voter.producers ) {
+            for ( auto acnt : get_voter_producers( voter ) ) {
                auto& prod = _producers.get( acnt.value, "producer not found" ); //data corruption
                const double init_total_votes = prod.total_votes;
                _producers.modify( prod, same_payer, [&]( auto& p ) {
@@ -518,7 +736,8 @@ namespace eosiosystem {
       if(voter.is_proxy){
          totalStake += voter.proxied_vote_weight;
       }
-      double new_weight = inverse_vote_weight((double)totalStake, voter.producers.size());
+      const auto voter_producers = get_voter_producers(voter);
+      double new_weight = inverse_vote_weight((double)totalStake, voter_producers.size());
       double delta = new_weight - voter.last_vote_weight;
 
       if (voter.proxy) { // this part should never happen since the function is called only on proxies
@@ -531,12 +750,21 @@ namespace eosiosystem {
             propagate_weight_change(proxy);
          }
       } else {
-         for (auto acnt : voter.producers) {
-            auto &pitr = _producers.get(acnt.value, "producer not found"); // data corruption
-            _producers.modify(pitr, same_payer, [&](auto &p) {
-               p.total_votes += delta;
-               _gstate.total_producer_vote_weight += delta;
-            });
+         if (delta != 0) {
+            for (auto acnt : voter_producers) {
+               add_producer_votes(_producers.get(acnt.value, "producer not found"), delta); // data corruption
+            }
+         }
+
+         vote_recalc_singleton recalc_sing( get_self(), get_self().value );
+         if( recalc_sing.exists() ) {
+            auto recalc = recalc_sing.get();
+            if( recalc.is_tallied( voter.owner ) ) {
+               for (auto acnt : voter_producers) {
+                  apply_recalc_vote_delta( recalc, acnt, delta );
+               }
+               recalc_sing.set( recalc, get_self() );
+            }
          }
       }
 
@@ -548,37 +776,446 @@ namespace eosiosystem {
    }
 
    // TELOS BEGIN
+   /*
+   * Rebuilds every producer's total_votes from the voters table once the global vote weight has drifted
+   * below zero. The rebuild runs as a resumable job spread across onblock calls: tally rows are seeded for
+   * the registered producers, voters are tallied a few at a time, then the tallies replace the producer totals.
+   * Proxies are disabled, so the proxied_vote_weight kept on proxy rows is trusted as is.
+   */
    void system_contract::recalculate_votes(){
-    if (_gstate.total_producer_vote_weight <= -0.1){ // -0.1 threshold for floating point calc ?
-        _gstate.total_producer_vote_weight = 0;
-        _gstate.total_activated_stake = 0;
-        for(auto producer = _producers.begin(); producer != _producers.end(); ++producer){
-            _producers.modify(producer, same_payer, [&](auto &p) {
-                p.total_votes = 0;
-            });
-        }
-        boost::container::flat_map< name, bool> processed_proxies;
-        for (auto voter = _voters.begin(); voter != _voters.end(); ++voter) {
-            if(voter->proxy && !processed_proxies[voter->proxy]){
-                auto proxy = _voters.find(voter->proxy.value);
-                _voters.modify( proxy, same_payer, [&]( auto& av ) {
-                    av.last_vote_weight = 0;
-                    av.last_stake = 0;
-                    av.proxied_vote_weight = 0;
-                });
-                processed_proxies[voter->proxy] = true;
+      vote_recalc_singleton recalc_sing( get_self(), get_self().value );
+      if( !recalc_sing.exists() ) {
+         if( _gstate.total_producer_vote_weight > -0.1 ) { // -0.1 threshold for floating point calc
+            return;
+         }
+         recalc_sing.set( vote_recalc_state{}, get_self() );
+      }
+
+      auto recalc = recalc_sing.get();
+      vote_tally_table tally( get_self(), get_self().value );
+
+      switch( static_cast<recalc_phase>( recalc.phase ) ) {
+         case recalc_phase::reset: {
+            uint32_t budget = recalc_producers_per_block;
+            auto prod = _producers.upper_bound( recalc.cursor.value );
+            for( ; prod != _producers.end() && budget > 0; ++prod, --budget ) {
+               ONBLOCK_ROWS_READ( 2 );
+               if( tally.find( prod->owner.value ) == tally.end() ) {
+                  tally.emplace( get_self(), [&]( auto& t ) {
+                     t.owner = prod->owner;
+                  });
+                  ONBLOCK_ROWS_WRITTEN( 1 );
+               }
+               recalc.cursor = prod->owner;
+            }
+            if( prod == _producers.end() ) {
+               recalc.phase  = static_cast<uint8_t>(recalc_phase::tally);
+               recalc.cursor = name();
+            }
+            break;
+         }
+         case recalc_phase::tally: {
+            uint32_t budget = recalc_voters_per_block;
+            auto voter = _voters.upper_bound( recalc.cursor.value );
+            for( ; voter != _voters.end() && budget > 0; ++voter, --budget ) {
+               recalc.cursor = voter->owner;
+               ONBLOCK_ROWS_READ( 1 );
+               if( voter->proxy ) { // weight already counted through the proxy's proxied_vote_weight
+                  continue;
+               }
+
+               auto totalStaked = voter->staked;
+               if( voter->is_proxy ) {
+                  totalStaked += voter->proxied_vote_weight;
+               }
+               const auto voter_producers = get_voter_producers( *voter );
+               if( voter_producers.size() == 0 ) {
+                  totalStaked = 0;
+               }
+
+               const double weight = inverse_vote_weight( (double)totalStaked, (double)voter_producers.size() );
+               for( const auto& p : voter_producers ) {
+                  auto titr = tally.find( p.value );
+                  if( titr == tally.end() ) { // not a registered producer
+                     continue;
+                  }
+                  tally.modify( titr, same_payer, [&]( auto& t ) {
+                     t.total_votes += weight;
+                  });
+                  ONBLOCK_ROWS_WRITTEN( 1 );
+                  recalc.total_producer_vote_weight += weight;
+               }
+               recalc.total_activated_stake += totalStaked;
+
+               if( voter->last_vote_weight != weight || voter->last_stake != totalStaked ) {
+                  _voters.modify( voter, same_payer, [&]( auto& av ) {
+                     av.last_vote_weight = weight;
+                     av.last_stake       = totalStaked;
+                  });
+                  ONBLOCK_ROWS_WRITTEN( 1 );
+               }
             }
-            if(!voter->is_proxy || !processed_proxies[voter->owner]){
-                _voters.modify( voter, same_payer, [&]( auto& av ) {
-                    av.last_vote_weight = 0;
-                    av.last_stake = 0;
-                    av.proxied_vote_weight = 0;
-                });
-                processed_proxies[voter->owner] = true;
+            if( voter == _voters.end() ) {
+               recalc.phase = static_cast<uint8_t>(recalc_phase::apply);
             }
-            update_votes(voter->owner, voter->proxy, voter->producers, true);
-        }
-    }
+            break;
+         }
+         case recalc_phase::apply: {
+            uint32_t budget = recalc_producers_per_block;
+            auto titr = tally.begin();
+            while( titr != tally.end() && budget > 0 ) {
+               auto prod = _producers.find( titr->owner.value );
+               ONBLOCK_ROWS_READ( 2 );
+               if( prod != _producers.end() && prod->total_votes != titr->total_votes ) {
+                  _producers.modify( prod, same_payer, [&]( auto& p ) {
+                     p.total_votes = titr->total_votes;
+                  });
+                  ONBLOCK_ROWS_WRITTEN( 1 );
+                  get_election_state().vote_epoch++;
+               }
+               ONBLOCK_ROWS_WRITTEN( 1 );
+               titr = tally.erase( titr );
+               --budget;
+            }
+            if( titr == tally.end() ) {
+               _gstate.total_producer_vote_weight = recalc.total_producer_vote_weight;
+               _gstate.total_activated_stake      = recalc.total_activated_stake;
+               recalc_sing.remove();
+               return;
+            }
+            break;
+         }
+      }
+
+      recalc_sing.set( recalc, get_self() );
+   }
+
+   void system_contract::setfixedvote() {
+      require_auth( get_self() );
+
+      check( !fixed_point_votes(), "fixed point votes are already enabled" );
+
+      vote_recalc_singleton recalc_sing( get_self(), get_self().value );
+      check( !recalc_sing.exists(), "a vote recalculation is in progress" );
+
+      fixed_vote_singleton fixed_sing( get_self(), get_self().value );
+      fixed_sing.set( fixed_vote_state{ true }, get_self() );
+      _fixed_point_votes = true;
+      // recount every vote with the integer weights, spread over the following blocks
+      recalc_sing.set( vote_recalc_state{}, get_self() );
+   }
+
+   // Total stake delegated by a voter, scans and records it once if the voter row does not track it yet
+   int64_t system_contract::get_delegated_out( const voter_info& voter ) {
+      if( has_field( voter.flags1, voter_info::flags1_fields::delegated_tracked ) ) {
+         return voter.reserved3.amount;
+      }
+      return sync_delegated_out( voter );
+   }
+
+   int64_t system_contract::sync_delegated_out( const voter_info& voter ) {
+      int64_t delegated = 0;
+      del_bandwidth_table del_tbl( get_self(), voter.owner.value );
+      for( auto del_itr = del_tbl.begin(); del_itr != del_tbl.end(); ++del_itr ) {
+         delegated += del_itr->net_weight.amount + del_itr->cpu_weight.amount;
+      }
+
+      _voters.modify( voter, same_payer, [&]( auto& v ) {
+         v.flags1    = set_field( v.flags1, voter_info::flags1_fields::delegated_tracked, true );
+         v.reserved3 = asset( delegated, core_symbol() );
+      });
+      return delegated;
+   }
+
+   void system_contract::syncdelband( const std::vector<name>& owners ) {
+      for( const auto& owner : owners ) {
+         sync_delegated_out( _voters.get( owner.value, "no voter found" ) );
+      }
+   }
+
+   // Only a change of a producer total that can move the ranking bumps the vote epoch, journaled deltas are
+   // checked when they are folded
+   void system_contract::add_producer_votes( const producer_info& prod, double delta ) {
+      if( delta == 0 ) {
+         return;
+      }
+      _gstate.total_producer_vote_weight += delta;
+
+      if( journal_votes() ) {
+         vote_journal_table journal( get_self(), get_self().value );
+         auto jitr = journal.find( prod.owner.value );
+         if( jitr == journal.end() ) {
+            journal.emplace( get_self(), [&]( auto& j ) {
+               j.producer = prod.owner;
+               j.delta    = delta;
+            });
+         } else {
+            journal.modify( jitr, same_payer, [&]( auto& j ) {
+               j.delta += delta;
+            });
+         }
+         return;
+      }
+
+      const double old_total = prod.total_votes;
+      _producers.modify( prod, same_payer, [&]( auto& p ) {
+         p.total_votes += delta;
+         if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
+            p.total_votes = 0;
+         }
+      });
+      if( affects_ranking( prod, old_total, prod.total_votes ) ) {
+         get_election_state().vote_epoch++;
+      }
+   }
+
+   // The last pass ranked the active producers at or above the cutoff, a producer that stays below it cannot
+   // enter that ranking: to pass a ranked producer it would have to rise above that producer's total, which is
+   // at or above the cutoff unless it dropped, and dropping bumped the epoch already
+   bool system_contract::affects_ranking( const producer_info& prod, double old_total, double new_total ) {
+      return prod.active() && std::max( old_total, new_total ) >= get_election_state().last_elected_cutoff;
+   }
+
+   void system_contract::fold_vote_journal() {
+      vote_journal_table journal( get_self(), get_self().value );
+      bool ranking_changed = false;
+      for( auto jitr = journal.begin(); jitr != journal.end(); ) {
+         ONBLOCK_ROWS_READ( 2 );
+         auto pitr = _producers.find( jitr->producer.value );
+         if( pitr != _producers.end() && jitr->delta != 0 ) {
+            const double old_total = pitr->total_votes;
+            _producers.modify( pitr, same_payer, [&]( auto& p ) {
+               p.total_votes += jitr->delta;
+               if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
+                  p.total_votes = 0;
+               }
+            });
+            ONBLOCK_ROWS_WRITTEN( 1 );
+            ranking_changed = ranking_changed || affects_ranking( *pitr, old_total, pitr->total_votes );
+         }
+         jitr = journal.erase( jitr );
+         ONBLOCK_ROWS_WRITTEN( 1 );
+      }
+      if( ranking_changed ) {
+         get_election_state().vote_epoch++;
+      }
+   }
+
+   void system_contract::setvotejrnl( bool enabled ) {
+      require_auth( get_self() );
+
+      check( journal_votes() != enabled, "action has no effect" );
+      vote_journal_config_singleton journal_sing( get_self(), get_self().value );
+      journal_sing.set( vote_journal_config{ enabled }, get_self() );
+      _journal_votes = enabled;
+      if( !enabled ) {
+         fold_vote_journal();
+      }
+   }
+
+   uint16_t system_contract::assign_producer_id( const name& producer, const name& payer ) {
+      producer_ids_table ids( get_self(), get_self().value );
+      auto idx = ids.get_index<"byowner"_n>();
+      auto itr = idx.find( producer.value );
+      if( itr != idx.end() ) {
+         return static_cast<uint16_t>( itr->id );
+      }
+
+      const uint64_t id = ids.available_primary_key();
+      check( id <= std::numeric_limits<uint16_t>::max(), "no producer ids left" );
+      ids.emplace( payer, [&]( auto& p ) {
+         p.id    = id;
+         p.owner = producer;
+      });
+      _producer_id_names.emplace( static_cast<uint16_t>( id ), producer );
+      return static_cast<uint16_t>( id );
+   }
+
+   // Owner of a producer id. Ids are never erased nor reassigned, so the rows read stay valid for the whole action
+   // and a voter table walk reads each producer once instead of once per vote.
+   name system_contract::producer_id_owner( uint16_t id ) {
+      auto itr = _producer_id_names.find( id );
+      if( itr == _producer_id_names.end() ) {
+         producer_ids_table ids( get_self(), get_self().value );
+         ONBLOCK_ROWS_READ( 1 );
+         itr = _producer_id_names.emplace( id, ids.get( id, "producer id not found" ).owner ).first; // data corruption
+      }
+      return itr->second;
+   }
+
+   std::vector<name> system_contract::get_voter_producers( const voter_info& voter ) {
+      if( !voter.producer_ids.has_value() ) {
+         return voter.producers;
+      }
+
+      std::vector<name> producers;
+      producers.reserve( voter.producer_ids->size() );
+      for( const auto id : *voter.producer_ids ) {
+         producers.push_back( producer_id_owner( id ) );
+      }
+      return producers;
+   }
+
+   // Previous vote of a voter about to vote for `producers`, whose ids are `producer_ids`. Only the ids missing from
+   // the new vote are looked up, the names of the kept producers are taken from `producers`.
+   std::vector<name> system_contract::get_voter_producers( const voter_info& voter, const std::vector<name>& producers,
+                                                           const std::vector<uint16_t>& producer_ids ) {
+      if( !voter.producer_ids.has_value() ) {
+         return voter.producers;
+      }
+
+      std::vector<std::pair<uint16_t, name>> kept;
+      kept.reserve( producer_ids.size() );
+      for( size_t i = 0; i < producer_ids.size(); ++i ) {
+         kept.emplace_back( producer_ids[i], producers[i] );
+      }
+      std::sort( kept.begin(), kept.end() );
+
+      std::vector<name> old_producers;
+      old_producers.reserve( voter.producer_ids->size() );
+      for( const auto id : *voter.producer_ids ) {
+         auto itr = std::lower_bound( kept.begin(), kept.end(), std::make_pair( id, name() ) );
+         if( itr != kept.end() && itr->first == id ) {
+            old_producers.push_back( itr->second );
+         } else {
+            old_producers.push_back( producer_id_owner( id ) );
+         }
+      }
+      // ids are kept in the name order of the producers, so old_producers is already sorted
+      return old_producers;
+   }
+
+   // Converts a vote to producer ids, fails if one of the producers has no id
+   bool system_contract::to_producer_ids( const std::vector<name>& producers, std::vector<uint16_t>& result ) {
+      producer_ids_table ids( get_self(), get_self().value );
+      auto idx = ids.get_index<"byowner"_n>();
+
+      result.clear();
+      result.reserve( producers.size() );
+      for( const auto& p : producers ) {
+         auto itr = idx.find( p.value );
+         if( itr == idx.end() ) {
+            return false;
+         }
+         result.push_back( static_cast<uint16_t>( itr->id ) );
+         _producer_id_names.emplace( result.back(), p );
+      }
+      return true;
+   }
+
+   void system_contract::migvoterids( uint16_t max ) {
+      require_auth( get_self() );
+
+      compact_votes_singleton compact_sing( get_self(), get_self().value );
+      auto migration = compact_sing.get_or_default();
+      check( migration.stage != static_cast<uint8_t>(compact_votes_stage::done), "votes are already stored as producer ids" );
+      if( migration.stage == static_cast<uint8_t>(compact_votes_stage::disabled) ) {
+         migration.stage  = static_cast<uint8_t>(compact_votes_stage::producers);
+         migration.cursor = name();
+      }
+
+      uint16_t processed = 0;
+      if( migration.stage == static_cast<uint8_t>(compact_votes_stage::producers) ) {
+         auto pitr = _producers.upper_bound( migration.cursor.value );
+         for( ; pitr != _producers.end() && processed < max; ++pitr, ++processed ) {
+            assign_producer_id( pitr->owner, get_self() );
+            migration.cursor = pitr->owner;
+         }
+         if( pitr == _producers.end() ) {
+            migration.stage  = static_cast<uint8_t>(compact_votes_stage::voters);
+            migration.cursor = name();
+         }
+         compact_sing.set( migration, get_self() );
+         _compact_votes = migration.stage;
+         return;
+      }
+
+      auto vitr = _voters.upper_bound( migration.cursor.value );
+      for( ; vitr != _voters.end() && processed < max; ++vitr, ++processed ) {
+         migration.cursor = vitr->owner;
+         if( vitr->producer_ids.has_value() || vitr->producers.empty() ) {
+            continue;
+         }
+         std::vector<uint16_t> producer_ids;
+         if( !to_producer_ids( vitr->producers, producer_ids ) ) {
+            continue;
+         }
+         _voters.modify( vitr, same_payer, [&]( auto& v ) {
+            v.producers.clear();
+            v.producer_ids.emplace( std::move(producer_ids) );
+         });
+      }
+      if( vitr == _voters.end() ) {
+         migration.stage = static_cast<uint8_t>(compact_votes_stage::done);
+      }
+      compact_sing.set( migration, get_self() );
+      _compact_votes = migration.stage;
+   }
+
+   void system_contract::migproxyidx( uint16_t max ) {
+      require_auth( get_self() );
+
+      proxy_index_singleton state_sing( get_self(), get_self().value );
+      auto state = state_sing.get_or_default();
+      check( !state.done, "proxy index is already migrated" );
+
+      // rows written before the index existed have no byproxy entry; erasing and emplacing them again adds it
+      uint16_t processed = 0;
+      auto vitr = _voters.upper_bound( state.cursor.value );
+      while( vitr != _voters.end() && processed < max ) {
+         state.cursor = vitr->owner;
+         ++processed;
+         if( !vitr->proxy ) {
+            ++vitr;
+            continue;
+         }
+         const voter_info voter = *vitr;
+         vitr = _voters.erase( vitr );
+         _voters.emplace( voter.owner, [&]( auto& v ) {
+            v = voter;
+         });
+      }
+      state.done = ( vitr == _voters.end() );
+      state_sing.set( state, get_self() );
+   }
+
+   void system_contract::syncproxy( const name& proxy ) {
+      proxy_index_singleton state_sing( get_self(), get_self().value );
+      check( state_sing.get_or_default().done, "proxy index is not migrated yet" );
+
+      auto pitr = _voters.find( proxy.value );
+      check( pitr != _voters.end(), "proxy not found" );
+
+      // a proxy's weight is the sum of the stake its delegators last voted with
+      double proxied_weight = 0;
+      auto idx = _voters.get_index<"byproxy"_n>();
+      for( auto ditr = idx.lower_bound( proxy.value ); ditr != idx.end() && ditr->proxy == proxy; ++ditr ) {
+         proxied_weight += ditr->last_stake;
+      }
+
+      if( pitr->proxied_vote_weight != proxied_weight ) {
+         _voters.modify( pitr, same_payer, [&]( auto& p ) {
+            p.proxied_vote_weight = proxied_weight;
+         });
+         if( pitr->is_proxy && pitr->producer_count() ) {
+            update_votes( pitr->owner, pitr->proxy, get_voter_producers( *pitr ), false );
+         }
+      }
+   }
+
+   void system_contract::apply_recalc_vote_delta( vote_recalc_state& recalc, const name& producer, double delta ) {
+      recalc.total_producer_vote_weight += delta;
+
+      vote_tally_table tally( get_self(), get_self().value );
+      auto titr = tally.find( producer.value );
+      if( titr != tally.end() ) {
+         tally.modify( titr, same_payer, [&]( auto& t ) {
+            t.total_votes += delta;
+            if ( t.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
+               t.total_votes = 0;
+            }
+         });
+      }
    }
    // TELOS END
 
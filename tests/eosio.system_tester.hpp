@@ -692,6 +692,58 @@ public:
    }
 
    // TELOS BEGIN
+   fc::variant get_name_bid( const account_name& newname ) {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "namebids"_n, newname );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "name_bid", data, abi_serializer_max_time );
+   }
+
+   fc::variant get_top_bid() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "topbid"_n, "topbid"_n );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "top_bid", data, abi_serializer_max_time );
+   }
+
+   fc::variant get_rex_config() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "rexconfig"_n, "rexconfig"_n );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "rex_config", data, abi_serializer_max_time );
+   }
+
+   fc::variant get_election_state() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "electstate"_n, "electstate"_n );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "election_state", data, abi_serializer_max_time );
+   }
+
+   fc::variant get_proxy_index() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "proxyidx"_n, "proxyidx"_n );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "proxy_index_state", data, abi_serializer_max_time );
+   }
+
+   fc::variant get_recalc_state() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "recalcvotes"_n, "recalcvotes"_n );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "vote_recalc_state", data, abi_serializer_max_time );
+   }
+
+   // Every row of the voters table, in primary key order
+   std::vector<fc::variant> get_all_voters() const {
+      std::vector<fc::variant> voters;
+      const auto& db = control->db();
+      namespace chain = eosio::chain;
+      const auto* t_id = db.find<chain::table_id_object, chain::by_code_scope_table>( boost::make_tuple( config::system_account_name, config::system_account_name, "voters"_n ) );
+      if ( !t_id ) {
+         return voters;
+      }
+      const auto& idx = db.get_index<chain::key_value_index, chain::by_scope_primary>();
+      for ( auto itr = idx.lower_bound( boost::make_tuple( t_id->id, 0 ) ); itr != idx.end() && itr->t_id == t_id->id; ++itr ) {
+         vector<char> data( itr->value.data(), itr->value.data() + itr->value.size() );
+         voters.emplace_back( abi_ser.binary_to_variant( "voter_info", data, abi_serializer::create_yield_function(abi_serializer_max_time) ) );
+      }
+      return voters;
+   }
+
+   fc::variant get_onblock_stats() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "onblockstat"_n, "onblockstat"_n );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "onblock_stats", data, abi_serializer_max_time );
+   }
+
    fc::variant get_payrate_info() {
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "payrate"_n, "payrate"_n );
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "payrates", data, abi_serializer_max_time );
@@ -919,8 +971,25 @@ public:
 
    fc::variant get_producer_info( const account_name& act ) {
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "producers"_n, act );
-      return abi_ser.binary_to_variant( "producer_info", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+      fc::variant info = abi_ser.binary_to_variant( "producer_info", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+      // TELOS BEGIN
+      // block counters are kept in the prodstats table for producers that have a row there
+      fc::variant stats = get_producer_stats( act );
+      if( !stats.is_null() ) {
+         return fc::mutable_variant_object( info )
+            ( "unpaid_blocks", stats["unpaid_blocks"] )
+            ( "lifetime_produced_blocks", stats["lifetime_produced_blocks"] );
+      }
+      // TELOS END
+      return info;
+   }
+
+   // TELOS BEGIN
+   fc::variant get_producer_stats( const account_name& act ) {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "prodstats"_n, act );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "producer_stats", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
    }
+   // TELOS END
    fc::variant get_producer_info( std::string_view act ) {
       return get_producer_info( account_name(act) );
    }
@@ -1257,6 +1326,79 @@ public:
       return producer_names;
    }
 
+   // Registers {defproducera, defproducerb, ...} up to defproducer<last> as producers
+   std::vector<account_name> setup_default_producers( char last ) {
+      std::vector<account_name> producer_names;
+      const std::string root("defproducer");
+      for ( char c = 'a'; c <= last; ++c ) {
+         producer_names.emplace_back(root + std::string(1, c));
+      }
+      setup_producer_accounts(producer_names);
+      for (const auto& p: producer_names) {
+         BOOST_REQUIRE_EQUAL( success(), regproducer(p) );
+      }
+      return producer_names;
+   }
+
+   // Funds `voter`, stakes 150.0000 for NET and 50.0000 for CPU and votes for `producers`
+   void stake_and_vote( const account_name& voter, const std::vector<account_name>& producers ) {
+      transfer( config::system_account_name, voter, core_sym::from_string("1000.0000"), config::system_account_name );
+      BOOST_REQUIRE_EQUAL( success(), stake( voter, core_sym::from_string("150.0000"), core_sym::from_string("50.0000") ) );
+      BOOST_REQUIRE_EQUAL( success(), vote( voter, producers ) );
+   }
+
+   // Overwrites the stored row `primary` of a system contract table, without touching its secondary indices.
+   // Lets a test put the contract in states its actions cannot reach, such as drifted vote totals.
+   void set_table_row( const name& scope, const name& table, uint64_t primary, const string& type, const fc::variant& row ) {
+      set_table_row_data( scope, table, primary, abi_ser.variant_to_binary( type, row, abi_serializer::create_yield_function(abi_serializer_max_time) ) );
+   }
+
+   void set_table_row_data( const name& scope, const name& table, uint64_t primary, const vector<char>& data ) {
+      namespace chain = eosio::chain;
+      auto& db = control->mutable_db();
+      const auto* t_id = db.find<chain::table_id_object, chain::by_code_scope_table>( boost::make_tuple( config::system_account_name, scope, table ) );
+      BOOST_REQUIRE( t_id != nullptr );
+      const auto* obj = db.find<chain::key_value_object, chain::by_scope_primary>( boost::make_tuple( t_id->id, primary ) );
+      BOOST_REQUIRE( obj != nullptr );
+      BOOST_REQUIRE_EQUAL( obj->value.size(), data.size() );
+      db.modify( *obj, [&]( auto& o ) {
+         o.value.assign( data.data(), data.size() );
+      });
+   }
+
+   // Stores the bool at `path` of a row as 2 instead of 1. The contract reads it as true but writes it back as 1,
+   // so the mark tells a test whether an action rewrote the row without changing it.
+   void mark_table_row( const name& scope, const name& table, const name& primary, const string& type, const std::vector<string>& path ) {
+      auto data = get_row_by_account( config::system_account_name, scope, table, primary );
+      const size_t offset = bool_offset( type, data, path );
+      BOOST_REQUIRE_EQUAL( 1, data[offset] );
+      data[offset] = 2;
+      set_table_row_data( scope, table, primary.to_uint64_t(), data );
+   }
+
+   bool is_table_row_marked( const name& scope, const name& table, const name& primary, const string& type, const std::vector<string>& path ) {
+      const auto data = get_row_by_account( config::system_account_name, scope, table, primary );
+      fc::variant value = abi_ser.binary_to_variant( type, data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+      for ( const auto& field : path ) {
+         value = fc::variant( value[field] );
+      }
+      return value.as_bool() && data[ bool_offset( type, data, path ) ] == 2;
+   }
+
+   // Position in the serialized row `data` of the bool at `path`, found by serializing the row with it cleared
+   size_t bool_offset( const string& type, const vector<char>& data, const std::vector<string>& path ) {
+      std::function<fc::variant( const fc::variant&, size_t )> cleared = [&]( const fc::variant& v, size_t i ) -> fc::variant {
+         return mutable_variant_object( v.get_object() )( path[i], i + 1 == path.size() ? fc::variant( false ) : cleared( v[path[i]], i + 1 ) );
+      };
+      BOOST_REQUIRE( !data.empty() );
+      const auto row = abi_ser.binary_to_variant( type, data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+      const auto other = abi_ser.variant_to_binary( type, cleared( row, 0 ), abi_serializer::create_yield_function(abi_serializer_max_time) );
+      BOOST_REQUIRE_EQUAL( data.size(), other.size() );
+      const auto mismatch = std::mismatch( data.begin(), data.end(), other.begin() );
+      BOOST_REQUIRE( mismatch.first != data.end() );
+      return mismatch.first - data.begin();
+   }
+
    uint64_t get_current_time() {
       return static_cast<uint64_t>( control->pending_block_time().time_since_epoch().count() );
    }
@@ -7,6 +7,15 @@
 
 using namespace eosio_system;
 
+// Five registered producers voted for by alice1111111, the starting point of the election tests
+struct voted_producers_tester : eosio_system_tester {
+   voted_producers_tester() : producer_names( setup_default_producers('e') ) {
+      stake_and_vote( "alice1111111"_n, producer_names );
+   }
+
+   const std::vector<account_name> producer_names;
+};
+
 BOOST_AUTO_TEST_SUITE(telos_system_tests)
 
 BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
@@ -388,4 +397,1003 @@ BOOST_FIXTURE_TEST_CASE(multi_producer_pay, eosio_system_tester, * boost::unit_t
    }
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE(onblock_stats, voted_producers_tester) try {
+   // the table is only part of contracts built with the SYSTEM_ONBLOCK_METRICS option
+   if ( abi_ser.get_table_type( "onblockstat"_n ).empty() ) {
+      BOOST_TEST_MESSAGE( "onblock metrics are not built in, skipping" );
+      return;
+   }
+   constexpr size_t blockinfo = 1, recalc_votes = 4, elect_producers = 5, vote_journal = 8;
+
+   // before activation onblock stops after the vote journal
+   produce_blocks( 10 );
+   auto stats = get_onblock_stats();
+   const uint64_t blocks = stats["window_blocks"].as<uint64_t>();
+   BOOST_REQUIRE( 10 <= blocks );
+   BOOST_REQUIRE_EQUAL( blocks, stats["current"][blockinfo]["invocations"].as<uint64_t>() );
+   BOOST_REQUIRE_EQUAL( blocks, stats["current"][vote_journal]["invocations"].as<uint64_t>() );
+   BOOST_REQUIRE_EQUAL( 0, stats["current"][recalc_votes]["invocations"].as<uint64_t>() );
+
+   // every stage counts its work once the network is active, the ranking walk reads the voted producers
+   activate_network();
+   produce_blocks( 10 );
+   stats = get_onblock_stats();
+   BOOST_REQUIRE_EQUAL( stats["window_blocks"].as<uint64_t>(), stats["current"][blockinfo]["invocations"].as<uint64_t>() );
+   BOOST_REQUIRE( 0 < stats["current"][recalc_votes]["invocations"].as<uint64_t>() );
+   BOOST_REQUIRE( 0 < stats["current"][elect_producers]["invocations"].as<uint64_t>() );
+   BOOST_REQUIRE( producer_names.size() <= stats["current"][elect_producers]["rows_read"].as<uint64_t>() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(producer_stats_counters, eosio_system_tester) try {
+   const asset net = core_sym::from_string("80.0000");
+   const asset cpu = core_sym::from_string("80.0000");
+   create_account_with_resources( "producvotera"_n, config::system_account_name, core_sym::from_string("1.0000"), false, net, cpu );
+
+   const auto producer_names = setup_default_producers('u');
+
+   // registration creates the compact counters row
+   for (auto a:producer_names) {
+      const auto stats = get_producer_stats(a);
+      BOOST_REQUIRE( !stats.is_null() );
+      BOOST_REQUIRE_EQUAL( 0, stats["unpaid_blocks"].as<uint32_t>() );
+      BOOST_REQUIRE_EQUAL( 0, stats["lifetime_produced_blocks"].as<uint32_t>() );
+   }
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( "producvotera"_n, "migprodstats"_n, mvo()("max", 10) ) );
+   // nothing left to migrate, later calls resume after the last producer visited
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "migprodstats"_n, mvo()("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "migprodstats"_n, mvo()("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "migprodstats"_n, mvo()("max", 10) ) );
+
+   // onblock counts the blocks of the scheduled producer in its stats row
+   const account_name prod = producer_names[0];
+   transfer( config::system_account_name, "producvotera", core_sym::from_string("400000000.0000"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "producvotera", core_sym::from_string("100000000.0000"), core_sym::from_string("100000000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "producvotera"_n, { prod } ) );
+   produce_blocks( (1000 - get_global_state()["block_num"].as<uint32_t>()) + 1 );
+   produce_blocks( 100 );
+   BOOST_REQUIRE_EQUAL( 1, control->active_producers().version );
+
+   const auto before = get_producer_stats( prod );
+   const uint32_t produced = before["lifetime_produced_blocks"].as<uint32_t>();
+   const uint32_t unpaid   = before["unpaid_blocks"].as<uint32_t>();
+   BOOST_REQUIRE( 0 < produced );
+   BOOST_REQUIRE_EQUAL( unpaid, get_global_state()["total_unpaid_blocks"].as<uint32_t>() );
+
+   produce_blocks( 10 );
+   const auto after = get_producer_stats( prod );
+   BOOST_REQUIRE_EQUAL( produced + 10, after["lifetime_produced_blocks"].as<uint32_t>() );
+   BOOST_REQUIRE_EQUAL( unpaid + 10,   after["unpaid_blocks"].as<uint32_t>() );
+   BOOST_REQUIRE_EQUAL( unpaid + 10,   get_global_state()["total_unpaid_blocks"].as<uint32_t>() );
+   // a producer that filled all of its slots has no missed blocks counted
+   const auto info = get_producer_info( prod );
+   BOOST_REQUIRE_EQUAL( 0, info["missed_blocks_per_rotation"].as<uint32_t>() );
+   BOOST_REQUIRE_EQUAL( 0, info["lifetime_missed_blocks"].as<uint32_t>() );
+   // every other producer stayed off the schedule
+   BOOST_REQUIRE_EQUAL( 0, get_producer_stats( producer_names[1] )["lifetime_produced_blocks"].as<uint32_t>() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(singleton_write_back, voted_producers_tester) try {
+   // a single producer schedule settles into onblocks that leave the schedule metrics as they are
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[0] } ) );
+   activate_network();
+   produce_blocks( 100 );
+   BOOST_REQUIRE_EQUAL( 1, control->active_producers().version );
+
+   const std::vector<string> activated = { "activation_cache", "activated" };
+   mark_table_row( config::system_account_name, "schedulemetr"_n, "schedulemetr"_n, "schedule_metrics_state", activated );
+   produce_blocks( 10 );
+   BOOST_REQUIRE( is_table_row_marked( config::system_account_name, "schedulemetr"_n, "schedulemetr"_n, "schedule_metrics_state", activated ) );
+   // nor do user actions that never read them
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("10.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE( is_table_row_marked( config::system_account_name, "schedulemetr"_n, "schedulemetr"_n, "schedule_metrics_state", activated ) );
+
+   // proposing a new schedule changes them and writes them back
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[0], producer_names[1] } ) );
+   produce_blocks( 250 );
+   BOOST_REQUIRE_EQUAL( 2, get_gmetrics_state()["producers_metric"].get_array().size() );
+   BOOST_REQUIRE( !is_table_row_marked( config::system_account_name, "schedulemetr"_n, "schedulemetr"_n, "schedule_metrics_state", activated ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(lazy_singletons, voted_producers_tester) try {
+   activate_network();
+   produce_blocks( 10 );
+
+   // a producers_metric length running past the end of the row makes the schedule metrics unreadable
+   const auto data = get_row_by_account( config::system_account_name, config::system_account_name, "schedulemetr"_n, "schedulemetr"_n );
+   const size_t length_offset = 8 + 4; // after last_onblock_caller and block_counter_correction
+   BOOST_REQUIRE_EQUAL( get_gmetrics_state()["producers_metric"].get_array().size(), data[length_offset] );
+   auto corrupted = data;
+   corrupted[length_offset] = 0x7f;
+   set_table_row_data( config::system_account_name, "schedulemetr"_n, "schedulemetr"_n.to_uint64_t(), corrupted );
+
+   // user actions that do not need them never load them
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("10.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), buyram( "alice1111111", "alice1111111", core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[0], producer_names[1] } ) );
+
+   set_table_row_data( config::system_account_name, "schedulemetr"_n, "schedulemetr"_n.to_uint64_t(), data );
+   produce_block();
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(producer_metric_slots, voted_producers_tester) try {
+   activate_network();
+   for ( int i = 0; i < 100 && control->active_producers().version == 0; ++i ) {
+      produce_block();
+   }
+   BOOST_REQUIRE_EQUAL( 1, control->active_producers().version );
+
+   // producers_metric follows the order of the active schedule
+   const auto metrics = get_gmetrics_state()["producers_metric"].get_array();
+   const auto& schedule = control->active_producers().producers;
+   BOOST_REQUIRE_EQUAL( schedule.size(), metrics.size() );
+   for ( size_t i = 0; i < schedule.size(); ++i ) {
+      BOOST_REQUIRE_EQUAL( schedule[i].producer_name, metrics[i]["bp_name"].as<name>() );
+   }
+
+   // so the slot of a block points at the metric of its producer
+   for ( int i = 0; i < 3 * 12 * int(metrics.size()); ++i ) {
+      produce_block();
+      const uint32_t slot  = control->head_block_header().timestamp.slot;
+      const uint32_t index = ( slot % ( metrics.size() * 12 ) ) / 12;
+      BOOST_REQUIRE_EQUAL( control->head_block_producer(), metrics[index]["bp_name"].as<name>() );
+   }
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(schedule_activation_cache, voted_producers_tester) try {
+   activate_network();
+   for ( int i = 0; i < 100 && control->active_producers().version == 0; ++i ) {
+      produce_block();
+   }
+   BOOST_REQUIRE_EQUAL( 1, control->active_producers().version );
+   produce_blocks( 2 );
+
+   // onblock sees the proposed schedule become active
+   auto metrics = get_gmetrics_state();
+   auto cache = metrics["activation_cache"];
+   BOOST_REQUIRE_EQUAL( true, cache["activated"].as_bool() );
+   BOOST_REQUIRE_EQUAL( producer_names.size(), cache["proposed"]["count"].as<uint32_t>() );
+   BOOST_REQUIRE_EQUAL( cache["proposed"]["count"].as<uint32_t>(), cache["active"]["count"].as<uint32_t>() );
+   BOOST_REQUIRE_EQUAL( cache["proposed"]["hash"].as<uint64_t>(), cache["active"]["hash"].as<uint64_t>() );
+
+   // while the active schedule keeps its fingerprint the cached answer is trusted as is
+   set_table_row( config::system_account_name, "schedulemetr"_n, "schedulemetr"_n.to_uint64_t(), "schedule_metrics_state",
+                  mutable_variant_object( metrics.get_object() )
+                     ( "activation_cache", mutable_variant_object( cache.get_object() )( "activated", false ) ) );
+   produce_block();
+   BOOST_REQUIRE_EQUAL( false, get_gmetrics_state()["activation_cache"]["activated"].as_bool() );
+
+   // a different fingerprint misses the cache and compares the schedules again
+   metrics = get_gmetrics_state();
+   cache   = metrics["activation_cache"];
+   const auto active = cache["active"];
+   set_table_row( config::system_account_name, "schedulemetr"_n, "schedulemetr"_n.to_uint64_t(), "schedule_metrics_state",
+                  mutable_variant_object( metrics.get_object() )
+                     ( "activation_cache", mutable_variant_object( cache.get_object() )
+                        ( "active", mutable_variant_object( active.get_object() )( "hash", active["hash"].as<uint64_t>() + 1 ) ) ) );
+   produce_block();
+   cache = get_gmetrics_state()["activation_cache"];
+   BOOST_REQUIRE_EQUAL( true, cache["activated"].as_bool() );
+   BOOST_REQUIRE_EQUAL( active["hash"].as<uint64_t>(), cache["active"]["hash"].as<uint64_t>() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(election_state_seeding, eosio_system_tester) try {
+   // init seeds the active producer count on a new chain, initelect is only for upgraded ones
+   BOOST_REQUIRE_EQUAL( 0, get_election_state()["active_producers"].as<uint32_t>() );
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( "alice1111111"_n, "initelect"_n, mvo() ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("election state is already initialized"),
+                        push_action( config::system_account_name, "initelect"_n, mvo() ) );
+
+   // the count follows registrations and deactivations without walking the producers table
+   const auto producer_names = setup_default_producers('c');
+   BOOST_REQUIRE_EQUAL( 3, get_election_state()["active_producers"].as<uint32_t>() );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( producer_names[0] ) );
+   BOOST_REQUIRE_EQUAL( 3, get_election_state()["active_producers"].as<uint32_t>() );
+   BOOST_REQUIRE_EQUAL( success(), push_action( producer_names[1], "unregprod"_n, mvo()("producer", producer_names[1]) ) );
+   BOOST_REQUIRE_EQUAL( 2, get_election_state()["active_producers"].as<uint32_t>() );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( producer_names[1] ) );
+   BOOST_REQUIRE_EQUAL( 3, get_election_state()["active_producers"].as<uint32_t>() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(vote_recalculation, voted_producers_tester) try {
+   // enough voters to spread the tally over several blocks
+   std::vector<account_name> voters;
+   for ( int i = 0; i < 45; ++i ) {
+      voters.emplace_back( std::string("rcvoter") + char('a' + i / 26) + char('a' + i % 26) );
+   }
+   setup_producer_accounts( voters );
+   for ( size_t i = 0; i < voters.size(); ++i ) {
+      stake_and_vote( voters[i], vector<account_name>(producer_names.begin(), producer_names.begin() + i % producer_names.size() + 1) );
+   }
+   activate_network();
+
+   // drift a producer total away from its voters' weights, the negative global total starts the recount
+   auto prod = abi_ser.binary_to_variant( "producer_info",
+                                          get_row_by_account( config::system_account_name, config::system_account_name, "producers"_n, producer_names[0] ),
+                                          abi_serializer::create_yield_function(abi_serializer_max_time) );
+   set_table_row( config::system_account_name, "producers"_n, producer_names[0].to_uint64_t(), "producer_info",
+                  mutable_variant_object( prod.get_object() )( "total_votes", 1e15 ) );
+   set_table_row( config::system_account_name, "global"_n, "global"_n.to_uint64_t(), "eosio_global_state",
+                  mutable_variant_object( get_global_state().get_object() )( "total_producer_vote_weight", -1.0 ) );
+
+   produce_block();
+   BOOST_REQUIRE_EQUAL( 1, get_recalc_state()["phase"].as<uint8_t>() );
+   BOOST_REQUIRE_EQUAL( name(), get_recalc_state()["cursor"].as<name>() );
+
+   // one block tallies a bounded batch of voters
+   produce_block();
+   BOOST_REQUIRE_EQUAL( 1, get_recalc_state()["phase"].as<uint8_t>() );
+   const auto cursor = get_recalc_state()["cursor"].as<name>();
+   BOOST_REQUIRE_EQUAL( get_all_voters()[19]["owner"].as<name>(), cursor );
+   BOOST_REQUIRE( voters.front() < cursor && cursor < voters.back() );
+
+   // votes cast mid-run, by voters on both sides of the cursor
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[1], producer_names[3] } ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( voters.front(), { producer_names[2], producer_names[4] } ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( voters[1], core_sym::from_string("75.0000"), core_sym::from_string("0.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( voters.back(), { producer_names[0] } ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( voters[voters.size() - 2], core_sym::from_string("25.0000"), core_sym::from_string("0.0000") ) );
+
+   produce_blocks( 5 );
+   BOOST_REQUIRE( get_recalc_state().is_null() );
+
+   // the result matches a recount from scratch of every voter row
+   const auto weight = []( double stake, size_t n ) {
+      return ( std::sin(M_PI * ( double(n) / 30 ) - M_PI_2) + 1.0 ) / 2.0 * stake;
+   };
+   std::map<name, double> totals;
+   double total_weight = 0;
+   for ( const auto& v : get_all_voters() ) {
+      if ( v["proxy"].as<name>() != name() ) {
+         continue;
+      }
+      const auto producers = v["producers"].as<vector<name>>();
+      double staked = v["staked"].as_int64();
+      if ( v["is_proxy"].as_bool() ) {
+         staked += v["proxied_vote_weight"].as_double();
+      }
+      const double w = producers.empty() ? 0 : weight( staked, producers.size() );
+      BOOST_REQUIRE_CLOSE( w, v["last_vote_weight"].as_double(), 1e-9 );
+      for ( const auto& p : producers ) {
+         totals[p] += w;
+         total_weight += w;
+      }
+   }
+   for ( const auto& p : producer_names ) {
+      BOOST_REQUIRE_CLOSE( totals[p], get_producer_info( p )["total_votes"].as_double(), 1e-9 );
+   }
+   BOOST_REQUIRE_CLOSE( total_weight, get_global_state()["total_producer_vote_weight"].as_double(), 1e-9 );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(schedule_proposal_skip, voted_producers_tester) try {
+   setup_producer_accounts( { "defproducerf"_n } );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducerf"_n ) );
+   activate_network();
+   for ( int i = 0; i < 100 && control->active_producers().version == 0; ++i ) {
+      produce_block();
+   }
+   BOOST_REQUIRE_EQUAL( 1, control->active_producers().version );
+   produce_blocks( 250 );
+
+   // with the ranking unchanged, passes neither propose the schedule nor fail to
+   const auto proposed = get_global_state()["last_proposed_schedule_update"].as_string();
+   produce_blocks( 250 );
+   auto election = get_election_state();
+   BOOST_REQUIRE_EQUAL( election["vote_epoch"].as_uint64(), election["last_elected_epoch"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( proposed, get_global_state()["last_proposed_schedule_update"].as_string() );
+   BOOST_REQUIRE_EQUAL( 1, control->active_producers().version );
+
+   // a schedule the chain turns down, here the active one under a stale digest, is tried again on every pass
+   const auto stale = fc::sha256::hash( std::string("stale") );
+   set_table_row( config::system_account_name, "electstate"_n, "electstate"_n.to_uint64_t(), "election_state",
+                  mutable_variant_object( election.get_object() )
+                     ( "last_elected_epoch", election["vote_epoch"].as_uint64() - 1 )
+                     ( "last_schedule_digest", stale ) );
+   produce_blocks( 250 );
+   election = get_election_state();
+   BOOST_REQUIRE_EQUAL( election["vote_epoch"].as_uint64() - 1, election["last_elected_epoch"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( stale.str(), election["last_schedule_digest"].as_string() );
+   BOOST_REQUIRE_EQUAL( proposed, get_global_state()["last_proposed_schedule_update"].as_string() );
+
+   // until the ranking gives a schedule that is accepted
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[1], producer_names[2], producer_names[3],
+                                                            producer_names[4], "defproducerf"_n } ) );
+   produce_blocks( 250 );
+   election = get_election_state();
+   BOOST_REQUIRE_EQUAL( election["vote_epoch"].as_uint64(), election["last_elected_epoch"].as_uint64() );
+   BOOST_REQUIRE( stale.str() != election["last_schedule_digest"].as_string() );
+   BOOST_REQUIRE( proposed != get_global_state()["last_proposed_schedule_update"].as_string() );
+   for ( int i = 0; i < 1000 && control->active_producers().version == 1; ++i ) {
+      produce_block();
+   }
+   BOOST_REQUIRE_EQUAL( 2, control->active_producers().version );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(fixed_point_votes, eosio_system_tester) try {
+   const auto producer_names = setup_default_producers('z');
+   const auto first = [&]( size_t n ) { return vector<account_name>(producer_names.begin(), producer_names.begin() + n); };
+
+   stake_and_vote( "alice1111111"_n, producer_names );
+   const double staked = get_voter_info( "alice1111111" )["staked"].as_int64();
+   // the floating point curve used before fixed point votes are enabled
+   const auto double_weight = []( double stake, size_t n ) {
+      return ( std::sin(M_PI * ( double(n) / 30 ) - M_PI_2) + 1.0 ) / 2.0 * stake;
+   };
+   BOOST_REQUIRE_CLOSE( double_weight(staked, producer_names.size()),
+                        get_voter_info( "alice1111111" )["last_vote_weight"].as_double(), 1e-9 );
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( "alice1111111"_n, "setfixedvote"_n, mvo() ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "setfixedvote"_n, mvo() ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("fixed point votes are already enabled"),
+                        push_action( config::system_account_name, "setfixedvote"_n, mvo() ) );
+   // let onblock finish recounting the existing votes
+   produce_blocks( 10 );
+
+   // once enabled, vote weights are whole numbers of stake units within one unit of the old curve
+   for ( size_t n : { 1, 2, 7, 15, 23, 26 } ) {
+      BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, first(n) ) );
+      const double weight = get_voter_info( "alice1111111" )["last_vote_weight"].as_double();
+      BOOST_REQUIRE( 0 < weight );
+      BOOST_REQUIRE_EQUAL( weight, std::floor(weight) );
+      BOOST_REQUIRE( std::abs( weight - double_weight(staked, n) ) <= 1 );
+   }
+
+   // producer totals are exact sums of the stake weighted votes
+   stake_and_vote( "bob111111111"_n, first(10) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", core_sym::from_string("300.0000"), core_sym::from_string("0.0000") ) );
+   const double bob_staked = get_voter_info( "bob111111111" )["staked"].as_int64();
+   const double alice_weight = get_voter_info( "alice1111111" )["last_vote_weight"].as_double();
+   const double bob_weight   = get_voter_info( "bob111111111" )["last_vote_weight"].as_double();
+   BOOST_REQUIRE_EQUAL( bob_weight, std::floor(bob_weight) );
+
+   const double total = get_producer_info( producer_names[0] )["total_votes"].as_double();
+   BOOST_REQUIRE_EQUAL( alice_weight + bob_weight, total );
+   BOOST_REQUIRE( std::abs( total - ( double_weight(staked, 26) + double_weight(bob_staked, 10) ) ) <= 2 );
+   BOOST_REQUIRE_EQUAL( alice_weight, get_producer_info( producer_names[25] )["total_votes"].as_double() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(compact_producer_ids, eosio_system_tester) try {
+   const auto producer_names = setup_default_producers('e');
+
+   stake_and_vote( "alice1111111"_n, producer_names );
+   const double votes = get_producer_info( producer_names[0] )["total_votes"].as_double();
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( "alice1111111"_n, "migvoterids"_n, mvo()("max", 10) ) );
+   for ( int i = 0; i < 4; ++i ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "migvoterids"_n, mvo()("max", 100) ) );
+      produce_block();
+      if ( get_voter_info( "alice1111111" )["producers"].get_array().empty() )
+         break;
+   }
+   BOOST_REQUIRE( get_voter_info( "alice1111111" )["producers"].get_array().empty() );
+   BOOST_REQUIRE_EQUAL( votes, get_producer_info( producer_names[0] )["total_votes"].as_double() );
+
+   // votes cast from stored producer ids move with the voter's stake
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("100.0000"), core_sym::from_string("0.0000") ) );
+   BOOST_REQUIRE( votes < get_producer_info( producer_names[0] )["total_votes"].as_double() );
+
+   // the kept producers move to the new weight, the dropped ones lose the old one
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[1], producer_names[3] } ) );
+   const double weight = get_voter_info( "alice1111111" )["last_vote_weight"].as_double();
+   BOOST_REQUIRE( get_producer_info( producer_names[0] )["total_votes"].as_double() < 1 );
+   BOOST_REQUIRE( get_producer_info( producer_names[4] )["total_votes"].as_double() < 1 );
+   BOOST_REQUIRE_CLOSE( weight, get_producer_info( producer_names[1] )["total_votes"].as_double(), 1e-9 );
+   BOOST_REQUIRE_CLOSE( weight, get_producer_info( producer_names[3] )["total_votes"].as_double(), 1e-9 );
+   BOOST_REQUIRE_EQUAL( 2, get_voter_info( "alice1111111" )["producer_ids"].get_array().size() );
+
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[1] } ) );
+   BOOST_REQUIRE( get_producer_info( producer_names[0] )["total_votes"].as_double() < 1 );
+   BOOST_REQUIRE( get_producer_info( producer_names[3] )["total_votes"].as_double() < 1 );
+   BOOST_REQUIRE_CLOSE( get_voter_info( "alice1111111" )["last_vote_weight"].as_double(),
+                        get_producer_info( producer_names[1] )["total_votes"].as_double(), 1e-9 );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(vote_merge_diff, voted_producers_tester) try {
+   const auto is_marked = [&]( const account_name& p ) {
+      return is_table_row_marked( config::system_account_name, "producers"_n, p, "producer_info", { "is_active" } );
+   };
+   const auto mark_all = [&]() {
+      for ( const auto& p : producer_names ) {
+         mark_table_row( config::system_account_name, "producers"_n, p, "producer_info", { "is_active" } );
+      }
+   };
+
+   // the same vote with the same stake writes no producer row
+   mark_all();
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, producer_names ) );
+   for ( const auto& p : producer_names ) {
+      BOOST_REQUIRE( is_marked( p ) );
+   }
+
+   // swapping one producer for another of a vote keeps the weight of the others, only the swapped rows are written
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[0], producer_names[1] } ) );
+   mark_all();
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[0], producer_names[2] } ) );
+   BOOST_REQUIRE( is_marked( producer_names[0] ) );
+   BOOST_REQUIRE( !is_marked( producer_names[1] ) );
+   BOOST_REQUIRE( !is_marked( producer_names[2] ) );
+   BOOST_REQUIRE( is_marked( producer_names[3] ) );
+   BOOST_REQUIRE( get_producer_info( producer_names[1] )["total_votes"].as_double() < 1 );
+   BOOST_REQUIRE_CLOSE( get_producer_info( producer_names[0] )["total_votes"].as_double(),
+                        get_producer_info( producer_names[2] )["total_votes"].as_double(), 1e-9 );
+
+   // a stake change moves every voted producer
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("10.0000"), core_sym::from_string("0.0000") ) );
+   BOOST_REQUIRE( !is_marked( producer_names[0] ) );
+   BOOST_REQUIRE( is_marked( producer_names[3] ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(delegated_stake_total, eosio_system_tester) try {
+   transfer( "eosio", "alice1111111", core_sym::from_string("1000.0000"), "eosio" );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("100.0000"), core_sym::from_string("50.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "bob111111111", core_sym::from_string("20.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("180.0000"), get_voter_info( "alice1111111" )["reserved3"].as<asset>() );
+
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", "bob111111111", core_sym::from_string("20.0000"), core_sym::from_string("0.0000") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("160.0000"), get_voter_info( "alice1111111" )["reserved3"].as<asset>() );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( "bob111111111"_n, "syncdelband"_n, mvo()("owners", vector<account_name>{ "alice1111111"_n }) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("160.0000"), get_voter_info( "alice1111111" )["reserved3"].as<asset>() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(voteupdbatch_refreshes_voters, eosio_system_tester) try {
+   const auto producer_names = setup_default_producers('c');
+   const std::vector<account_name> voters = { "alice1111111"_n, "bob111111111"_n };
+   const int64_t staked = core_sym::from_string("200.0000").get_amount();
+
+   for ( const auto& v : voters ) {
+      stake_and_vote( v, producer_names );
+      BOOST_REQUIRE_EQUAL( success(), deposit( v, core_sym::from_string("100.0000") ) );
+      BOOST_REQUIRE_EQUAL( success(), buyrex( v, core_sym::from_string("100.0000") ) );
+   }
+   const int64_t init_vote_stake = get_rex_balance_obj( voters[0] )["vote_stake"].as<asset>().get_amount();
+   BOOST_REQUIRE_EQUAL( staked + init_vote_stake, get_voter_info( voters[0] )["staked"].as_int64() );
+
+   // rent fees raise the REX price, the vote stake of the REX holders is now stale
+   const account_name carol = "carolaccount"_n;
+   setup_rex_accounts( { carol }, core_sym::from_string("100.0000") );
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( carol, carol, core_sym::from_string("10.0000") ) );
+   produce_block( fc::days(5) );
+   BOOST_REQUIRE_EQUAL( success(), rexexec( carol, 2 ) );
+   const double votes = get_producer_info( producer_names[0] )["total_votes"].as_double();
+   BOOST_REQUIRE_EQUAL( init_vote_stake, get_rex_balance_obj( voters[0] )["vote_stake"].as<asset>().get_amount() );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("max must be positive"),
+                        push_action( voters[0], "voteupdbatch"_n, mvo()("max", 0) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( voters[0], "voteupdbatch"_n, mvo()("max", 10) ) );
+
+   double weights = 0;
+   for ( const auto& v : voters ) {
+      const int64_t vote_stake = get_rex_balance_obj( v )["vote_stake"].as<asset>().get_amount();
+      BOOST_REQUIRE( init_vote_stake < vote_stake );
+      const auto info = get_voter_info( v );
+      BOOST_REQUIRE_EQUAL( staked + vote_stake, info["staked"].as_int64() );
+      BOOST_REQUIRE_EQUAL( staked + vote_stake, info["last_stake"].as_int64() );
+      weights += info["last_vote_weight"].as_double();
+   }
+   // both voters' changes land on every producer they vote for
+   for ( const auto& p : producer_names ) {
+      const double total = get_producer_info( p )["total_votes"].as_double();
+      BOOST_REQUIRE( votes < total );
+      BOOST_REQUIRE_CLOSE( weights, total, 1e-9 );
+   }
+
+   // nothing changed since, a second pass leaves the totals alone
+   const double refreshed = get_producer_info( producer_names[0] )["total_votes"].as_double();
+   produce_block();
+   BOOST_REQUIRE_EQUAL( success(), push_action( voters[1], "voteupdbatch"_n, mvo()("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( refreshed, get_producer_info( producer_names[0] )["total_votes"].as_double() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(changebw_refreshes_rex_vote_stake, eosio_system_tester) try {
+   const account_name alice = "aliceaccount"_n, carol = "carolaccount"_n;
+   setup_rex_accounts( { alice, carol }, core_sym::from_string("1000.0000") );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("500.0000") ) );
+   const int64_t init_vote_stake = get_rex_balance_obj( alice )["vote_stake"].as<asset>().get_amount();
+   const int64_t init_staked     = get_voter_info( alice )["staked"].as_int64();
+
+   // rent fees raise the REX price
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( carol, carol, core_sym::from_string("10.0000") ) );
+   produce_block( fc::days(5) );
+   BOOST_REQUIRE_EQUAL( success(), rexexec( carol, 2 ) );
+   BOOST_REQUIRE_EQUAL( init_vote_stake, get_rex_balance_obj( alice )["vote_stake"].as<asset>().get_amount() );
+
+   // staking to another account refreshes the REX vote stake and adds both changes to the voter row
+   transfer( config::system_account_name, alice, core_sym::from_string("20.0000"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( alice, carol, core_sym::from_string("10.0000"), core_sym::from_string("10.0000") ) );
+   const int64_t vote_stake = get_rex_balance_obj( alice )["vote_stake"].as<asset>().get_amount();
+   BOOST_REQUIRE( init_vote_stake < vote_stake );
+   BOOST_REQUIRE_EQUAL( init_staked + core_sym::from_string("20.0000").get_amount() + ( vote_stake - init_vote_stake ),
+                        get_voter_info( alice )["staked"].as_int64() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(refund_queue, eosio_system_tester) try {
+   activate_network();
+   const account_name alice = "alice1111111"_n, bob = "bob111111111"_n, carol = "carol1111111"_n;
+   const asset half = core_sym::from_string("50.0000");
+   for ( const auto& a : { alice, bob, carol } ) {
+      transfer( config::system_account_name, a, core_sym::from_string("1000.0000"), config::system_account_name );
+      BOOST_REQUIRE_EQUAL( success(), stake( a, core_sym::from_string("100.0000"), core_sym::from_string("100.0000") ) );
+   }
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( alice, "setrefundcfg"_n, mvo()("exec_max", 2) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("exec_max must be positive"),
+                        push_action( config::system_account_name, "setrefundcfg"_n, mvo()("exec_max", 0) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "setrefundcfg"_n, mvo()("exec_max", 2) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), unstake( alice, half, half ) );
+   BOOST_REQUIRE_EQUAL( success(), unstake( bob, half, half ) );
+   produce_block( fc::days(1) );
+   BOOST_REQUIRE_EQUAL( success(), unstake( carol, half, half ) );
+
+   // refunds that are not matured yet are skipped
+   BOOST_REQUIRE_EQUAL( success(), push_action( carol, "refundexec"_n, mvo()("owners", vector<account_name>{ alice, bob }) ) );
+   BOOST_REQUIRE( !get_refund_request( alice ).is_null() );
+
+   // onblock does not pay matured refunds, a keeper pushes refundexec for them
+   produce_block( fc::days(2) );
+   produce_blocks( 10 );
+   BOOST_REQUIRE( !get_refund_request( alice ).is_null() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("800.0000"), get_balance( alice ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("no owners to refund"),
+                        push_action( carol, "refundexec"_n, mvo()("owners", vector<account_name>{}) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("too many owners to refund"),
+                        push_action( carol, "refundexec"_n, mvo()("owners", vector<account_name>{ alice, bob, carol }) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( carol, "refundexec"_n, mvo()("owners", vector<account_name>{ alice, bob }) ) );
+   for ( const auto& a : { alice, bob } ) {
+      BOOST_REQUIRE( get_refund_request( a ).is_null() );
+      BOOST_REQUIRE_EQUAL( core_sym::from_string("900.0000"), get_balance( a ) );
+   }
+
+   // carol's refund matures a day later, an owner left out by the keeper still claims with refund
+   BOOST_REQUIRE_EQUAL( success(), push_action( alice, "refundexec"_n, mvo()("owners", vector<account_name>{ carol }) ) );
+   BOOST_REQUIRE( !get_refund_request( carol ).is_null() );
+   produce_block( fc::days(1) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( carol, "refund"_n, mvo()("owner", carol) ) );
+   BOOST_REQUIRE( get_refund_request( carol ).is_null() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("900.0000"), get_balance( carol ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( alice, "refundexec"_n, mvo()("owners", vector<account_name>{ carol }) ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(bid_refund_ledger, eosio_system_tester) try {
+   const account_name alice = "alice1111111"_n, bob = "bob111111111"_n, carol = "carol1111111"_n;
+   for ( const auto& a : { alice, bob, carol } ) {
+      transfer( config::system_account_name, a, core_sym::from_string("100.0000"), config::system_account_name );
+   }
+   BOOST_REQUIRE_EQUAL( success(), bidname( alice, "prefa"_n, core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), bidname( carol, "prefb"_n, core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), bidname( bob, "prefa"_n, core_sym::from_string("2.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), bidname( bob, "prefb"_n, core_sym::from_string("2.0000") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("99.0000"), get_balance( alice ) );
+
+   // only the listed bidders are paid, bidders with nothing owed are skipped
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("no bidders to refund"),
+                        push_action( bob, "bidrefexec"_n, mvo()("bidders", vector<account_name>{}) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( bob, "bidrefexec"_n, mvo()("bidders", vector<account_name>{ alice, bob }) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("100.0000"), get_balance( alice ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("99.0000"),  get_balance( carol ) );
+
+   // a bidder left out by the keeper claims its refund itself
+   BOOST_REQUIRE_EQUAL( success(), push_action( carol, "claimbidref"_n, mvo()("bidder", carol) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("100.0000"), get_balance( carol ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("refund not found"),
+                        push_action( carol, "claimbidref"_n, mvo()("bidder", carol) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( bob, "bidrefexec"_n, mvo()("bidders", vector<account_name>{ carol }) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("100.0000"), get_balance( carol ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(top_bid_tracking, eosio_system_tester) try {
+   const account_name alice = "alice1111111"_n, bob = "bob111111111"_n, carol = "carol1111111"_n;
+   for ( const auto& a : { alice, bob, carol } ) {
+      transfer( config::system_account_name, a, core_sym::from_string("100.0000"), config::system_account_name );
+   }
+   BOOST_REQUIRE( get_top_bid().is_null() );
+
+   BOOST_REQUIRE_EQUAL( success(), bidname( carol, "prefc"_n, core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE_EQUAL( "prefc", get_top_bid()["newname"].as_string() );
+   BOOST_REQUIRE_EQUAL( success(), bidname( alice, "prefa"_n, core_sym::from_string("2.0000") ) );
+   BOOST_REQUIRE_EQUAL( "prefa", get_top_bid()["newname"].as_string() );
+
+   // outbidding the top bid raises it
+   produce_block();
+   BOOST_REQUIRE_EQUAL( success(), bidname( bob, "prefa"_n, core_sym::from_string("3.0000") ) );
+   auto top = get_top_bid();
+   BOOST_REQUIRE_EQUAL( "prefa", top["newname"].as_string() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("3.0000").get_amount(), top["high_bid"].as_int64() );
+   BOOST_REQUIRE_EQUAL( get_name_bid( "prefa"_n )["last_bid_time"].as_string(), top["last_bid_time"].as_string() );
+
+   // outbidding a lower bid above the top makes it the new top
+   BOOST_REQUIRE_EQUAL( success(), bidname( alice, "prefc"_n, core_sym::from_string("5.0000") ) );
+   BOOST_REQUIRE_EQUAL( "prefc", get_top_bid()["newname"].as_string() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("5.0000").get_amount(), get_top_bid()["high_bid"].as_int64() );
+
+   // activate the chain, auctions close 14 days later
+   const auto producer_names = setup_default_producers('a');
+   create_account_with_resources( "producvotera"_n, config::system_account_name, core_sym::from_string("1.0000"), false,
+                                  core_sym::from_string("80.0000"), core_sym::from_string("80.0000") );
+   transfer( config::system_account_name, "producvotera", core_sym::from_string("400000000.0000"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "producvotera", core_sym::from_string("100000000.0000"), core_sym::from_string("100000000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "producvotera"_n, producer_names ) );
+   produce_blocks( (1000 - get_global_state()["block_num"].as<uint32_t>()) + 1 );
+   produce_block( fc::days(14) );
+   produce_blocks( 250 );
+
+   // closing the top auction moves the top to the next open bid
+   BOOST_REQUIRE( get_name_bid( "prefc"_n )["high_bid"].as_int64() < 0 );
+   BOOST_REQUIRE_EQUAL( "prefa", get_top_bid()["newname"].as_string() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("3.0000").get_amount(), get_top_bid()["high_bid"].as_int64() );
+
+   // claiming a closed name does not touch the top
+   create_account_with_resources( "prefc"_n, alice );
+   BOOST_REQUIRE_EQUAL( "prefa", get_top_bid()["newname"].as_string() );
+
+   // once every auction is closed there is no top bid left
+   produce_block( fc::days(1) );
+   produce_blocks( 250 );
+   BOOST_REQUIRE( get_name_bid( "prefa"_n )["high_bid"].as_int64() < 0 );
+   BOOST_REQUIRE_EQUAL( 0, get_top_bid()["high_bid"].as_int64() );
+   create_account_with_resources( "prefa"_n, bob );
+   BOOST_REQUIRE_EQUAL( 0, get_top_bid()["high_bid"].as_int64() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(vote_journal, eosio_system_tester) try {
+   const auto producer_names = setup_default_producers('c');
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( "alice1111111"_n, "setvotejrnl"_n, mvo()("enabled", true) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "setvotejrnl"_n, mvo()("enabled", true) ) );
+
+   stake_and_vote( "alice1111111"_n, producer_names );
+
+   // the vote is written to the producers by the next onblock
+   BOOST_REQUIRE_EQUAL( 0, get_producer_info( producer_names[0] )["total_votes"].as_double() );
+   produce_block();
+   BOOST_REQUIRE( 0 < get_producer_info( producer_names[0] )["total_votes"].as_double() );
+
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[1] } ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "setvotejrnl"_n, mvo()("enabled", false) ) );
+   BOOST_REQUIRE( get_producer_info( producer_names[0] )["total_votes"].as_double() < 1 );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(vote_journal_epoch, voted_producers_tester) try {
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "setvotejrnl"_n, mvo()("enabled", true) ) );
+   produce_block();
+   const uint64_t epoch = get_election_state()["vote_epoch"].as_uint64();
+
+   // a burst of vote changes on every producer is journaled without touching the epoch
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[0], producer_names[1] } ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("10.0000"), core_sym::from_string("0.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { producer_names[2], producer_names[3], producer_names[4] } ) );
+   BOOST_REQUIRE_EQUAL( epoch, get_election_state()["vote_epoch"].as_uint64() );
+
+   // and bumps it once when the next onblock folds it
+   produce_block();
+   BOOST_REQUIRE_EQUAL( epoch + 1, get_election_state()["vote_epoch"].as_uint64() );
+   BOOST_REQUIRE( get_producer_info( producer_names[0] )["total_votes"].as_double() < 1 );
+   BOOST_REQUIRE( 0 < get_producer_info( producer_names[4] )["total_votes"].as_double() );
+   produce_block();
+   BOOST_REQUIRE_EQUAL( epoch + 1, get_election_state()["vote_epoch"].as_uint64() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(bounded_ranking_walk, voted_producers_tester) try {
+   // a registered producer nobody votes for and a voted one that unregistered
+   setup_producer_accounts( { "defproducerf"_n } );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducerf"_n ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( producer_names[0], "unregprod"_n, mvo()("producer", producer_names[0]) ) );
+   BOOST_REQUIRE_EQUAL( producer_names.size(), get_election_state()["active_producers"].as<uint32_t>() );
+
+   activate_network();
+   for ( int i = 0; i < 100 && control->active_producers().version == 0; ++i ) {
+      produce_block();
+   }
+
+   // the walk stops at the first producer without votes or no longer active
+   std::vector<account_name> schedule;
+   for ( const auto& p : control->active_producers().producers ) {
+      schedule.push_back( p.producer_name );
+   }
+   std::sort( schedule.begin(), schedule.end() );
+   BOOST_REQUIRE( std::vector<account_name>( producer_names.begin() + 1, producer_names.end() ) == schedule );
+   // fewer than MAX_PRODUCERS ranked producers leave no cutoff
+   BOOST_REQUIRE_EQUAL( 0, get_election_state()["last_elected_cutoff"].as_double() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(vote_epoch_cutoff, eosio_system_tester) try {
+   std::vector<account_name> producer_names;
+   for ( int i = 0; i <= MAX_PRODUCERS; ++i ) {
+      producer_names.emplace_back( std::string("cutprod") + char('a' + i / 26) + char('a' + i % 26) );
+   }
+   setup_producer_accounts( producer_names );
+   for ( const auto& p : producer_names ) {
+      BOOST_REQUIRE_EQUAL( success(), regproducer( p ) );
+   }
+
+   // two large voters rank the first MAX_PRODUCERS producers, a small one keeps the last one below them
+   const account_name alice = "alice1111111"_n, bob = "bob111111111"_n, carol = "carol1111111"_n;
+   for ( const auto& v : { alice, bob } ) {
+      transfer( config::system_account_name, v, core_sym::from_string("100000.0000"), config::system_account_name );
+      BOOST_REQUIRE_EQUAL( success(), stake( v, core_sym::from_string("50000.0000"), core_sym::from_string("50000.0000") ) );
+   }
+   BOOST_REQUIRE_EQUAL( success(), vote( alice, std::vector<account_name>( producer_names.begin(), producer_names.begin() + 30 ) ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( bob, std::vector<account_name>( producer_names.begin() + 12, producer_names.begin() + MAX_PRODUCERS ) ) );
+   transfer( config::system_account_name, carol, core_sym::from_string("100.0000"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( carol, core_sym::from_string("1.0000"), core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( carol, { producer_names[MAX_PRODUCERS] } ) );
+
+   activate_network();
+   produce_blocks( 250 );
+   const double cutoff = get_election_state()["last_elected_cutoff"].as_double();
+   BOOST_REQUIRE( get_producer_info( producer_names[MAX_PRODUCERS] )["total_votes"].as_double() < cutoff );
+   BOOST_REQUIRE_EQUAL( cutoff, get_producer_info( producer_names[0] )["total_votes"].as_double() );
+
+   // a producer that stays below the cutoff cannot change the ranking
+   const uint64_t epoch = get_election_state()["vote_epoch"].as_uint64();
+   BOOST_REQUIRE_EQUAL( success(), stake( carol, core_sym::from_string("1.0000"), core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE( get_producer_info( producer_names[MAX_PRODUCERS] )["total_votes"].as_double() < cutoff );
+   BOOST_REQUIRE_EQUAL( epoch, get_election_state()["vote_epoch"].as_uint64() );
+
+   // a ranked producer can
+   BOOST_REQUIRE_EQUAL( success(), vote( carol, { producer_names[0] } ) );
+   BOOST_REQUIRE_EQUAL( epoch + 1, get_election_state()["vote_epoch"].as_uint64() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(proxy_index, eosio_system_tester) try {
+   const account_name alice = "alice1111111"_n, bob = "bob111111111"_n, carol = "carol1111111"_n;
+   for ( const auto& a : { alice, bob, carol } ) {
+      transfer( config::system_account_name, a, core_sym::from_string("1000.0000"), config::system_account_name );
+      BOOST_REQUIRE_EQUAL( success(), stake( a, core_sym::from_string("150.0000"), core_sym::from_string("50.0000") ) );
+   }
+
+   // proxy registration is disabled, so the rows of a proxy and its delegator are written as they were left
+   // before the byproxy index existed
+   const int64_t bob_stake = get_voter_info( bob )["staked"].as_int64();
+   auto proxy_row = get_voter_info( alice ).get_object();
+   set_table_row( config::system_account_name, "voters"_n, alice.to_uint64_t(), "voter_info",
+                  mutable_variant_object( proxy_row )("is_proxy", true)("proxied_vote_weight", 1.0) );
+   auto delegator_row = get_voter_info( bob ).get_object();
+   set_table_row( config::system_account_name, "voters"_n, bob.to_uint64_t(), "voter_info",
+                  mutable_variant_object( delegator_row )("proxy", alice)("last_stake", bob_stake) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("proxy index is not migrated yet"),
+                        push_action( carol, "syncproxy"_n, mvo()("proxy", alice) ) );
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( carol, "migproxyidx"_n, mvo()("max", 1) ) );
+
+   // the migration walks the voters a batch at a time
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "migproxyidx"_n, mvo()("max", 1) ) );
+   BOOST_REQUIRE_EQUAL( false, get_proxy_index()["done"].as<bool>() );
+   for ( int i = 0; i < 100 && !get_proxy_index()["done"].as<bool>(); ++i ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "migproxyidx"_n, mvo()("max", 2) ) );
+   }
+   BOOST_REQUIRE_EQUAL( true, get_proxy_index()["done"].as<bool>() );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("proxy index is already migrated"),
+                        push_action( config::system_account_name, "migproxyidx"_n, mvo()("max", 1) ) );
+   BOOST_REQUIRE_EQUAL( alice, get_voter_info( bob )["proxy"].as<account_name>() );
+
+   // the proxy's weight is recomputed from the delegators found through the index
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("proxy not found"),
+                        push_action( carol, "syncproxy"_n, mvo()("proxy", "nobody111111") ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( carol, "syncproxy"_n, mvo()("proxy", alice) ) );
+   BOOST_REQUIRE_EQUAL( double(bob_stake), get_voter_info( alice )["proxied_vote_weight"].as_double() );
+
+   // leaving the proxy moves the delegator out of the index
+   BOOST_REQUIRE_EQUAL( success(), vote( bob, {} ) );
+   BOOST_REQUIRE_EQUAL( name(), get_voter_info( bob )["proxy"].as<account_name>() );
+   BOOST_REQUIRE_EQUAL( success(), push_action( carol, "syncproxy"_n, mvo()("proxy", alice) ) );
+   BOOST_REQUIRE_EQUAL( 0.0, get_voter_info( alice )["proxied_vote_weight"].as_double() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(rex_return_ring, eosio_system_tester) try {
+   constexpr uint32_t total_intervals = 30 * 144;
+   constexpr uint32_t ring_slots      = 60;
+
+   const asset init_balance = core_sym::from_string("100000.0000");
+   const std::vector<account_name> accounts = { "aliceaccount"_n, "bobbyaccount"_n };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("100000.0000") ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("rex return pool not initialized yet"),
+                        push_action( config::system_account_name, "migretbucket"_n, mvo() ) );
+
+   const asset fee = core_sym::from_string("30.0000");
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, fee ) );
+   produce_block( fc::days(1) );
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, fee ) );
+   produce_block( fc::days(1) );
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( alice, "migretbucket"_n, mvo() ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "migretbucket"_n, mvo() ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("return buckets already use the ring layout"),
+                        push_action( config::system_account_name, "migretbucket"_n, mvo() ) );
+
+   auto buckets = get_rex_return_buckets();
+   BOOST_REQUIRE_EQUAL( 1,          buckets["version"].as<uint8_t>() );
+   BOOST_REQUIRE_EQUAL( ring_slots, buckets["return_buckets"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( 2 * ( fee.get_amount() / total_intervals ),
+                        get_rex_return_pool()["current_rate_of_increase"].as<int64_t>() );
+
+   // the row keeps its size while buckets are added and expired
+   for ( uint8_t i = 0; i < 3; ++i ) {
+      BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, fee ) );
+      produce_block( fc::days(1) );
+   }
+   BOOST_REQUIRE_EQUAL( success(), rexexec( bob, 1 ) );
+   BOOST_REQUIRE_EQUAL( ring_slots, get_rex_return_buckets()["return_buckets"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( 5 * ( fee.get_amount() / total_intervals ),
+                        get_rex_return_pool()["current_rate_of_increase"].as<int64_t>() );
+
+   const asset init_lendable = get_rex_pool()["total_lendable"].as<asset>();
+   produce_block( fc::days(31) );
+   BOOST_REQUIRE_EQUAL( success(), rexexec( bob, 1 ) );
+   BOOST_REQUIRE_EQUAL( ring_slots, get_rex_return_buckets()["return_buckets"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( 0,          get_rex_return_pool()["current_rate_of_increase"].as<int64_t>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("100000.0000").get_amount() + 5 * fee.get_amount(),
+                        get_rex_pool()["total_lendable"].as<asset>().get_amount() );
+   BOOST_TEST_REQUIRE( init_lendable.get_amount() < get_rex_pool()["total_lendable"].as<asset>().get_amount() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(rex_maturity_ring, eosio_system_tester) try {
+   constexpr uint32_t ring_size = 6; // 5 maturity days and the savings slot
+
+   const asset init_balance = core_sym::from_string("10000.0000");
+   const std::vector<account_name> accounts = { "aliceaccount"_n, "bobbyaccount"_n };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance );
+
+   const asset payment = core_sym::from_string("100.0000");
+   BOOST_REQUIRE_EQUAL( success(), buyrex( bob, payment ) );
+   produce_block( fc::days(1) );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( bob, payment ) );
+   const asset rex_balance_0 = get_rex_balance_obj( bob )["rex_balance"].as<asset>();
+   const asset rex_bucket( rex_balance_0.get_amount() / 2, rex_balance_0.get_symbol() );
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( alice, "migrexbal"_n, mvo()("owners", std::vector<account_name>{ bob }) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("account has no REX balance"),
+                        push_action( config::system_account_name, "migrexbal"_n, mvo()("owners", std::vector<account_name>{ alice }) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "migrexbal"_n, mvo()("owners", std::vector<account_name>{ bob }) ) );
+   auto rex_balance = get_rex_balance_obj( bob );
+   BOOST_REQUIRE_EQUAL( 1,         rex_balance["version"].as<uint8_t>() );
+   BOOST_REQUIRE_EQUAL( ring_size, rex_balance["rex_maturities"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( 0,         rex_balance["matured_rex"].as<int64_t>() );
+
+   // savings are taken from the latest maturity first
+   BOOST_REQUIRE_EQUAL( success(), mvtosavings( bob, rex_bucket ) );
+   rex_balance = get_rex_balance_obj( bob );
+   BOOST_REQUIRE_EQUAL( ring_size, rex_balance["rex_maturities"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( rex_bucket.get_amount(), rex_balance["rex_maturities"][ring_size - 1]["second"].as<int64_t>() );
+
+   BOOST_REQUIRE_EQUAL( success(), buyrex( bob, payment ) );
+   produce_block( fc::days(6) );
+   BOOST_REQUIRE_EQUAL( success(), updaterex( bob ) );
+   rex_balance = get_rex_balance_obj( bob );
+   BOOST_REQUIRE_EQUAL( ring_size, rex_balance["rex_maturities"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( 2 * rex_bucket.get_amount(), rex_balance["matured_rex"].as<int64_t>() );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient available rex"),
+                        sellrex( bob, asset( 3 * rex_bucket.get_amount(), rex_bucket.get_symbol() ) ) );
+   BOOST_REQUIRE_EQUAL( success(), mvfrsavings( bob, rex_bucket ) );
+   BOOST_REQUIRE_EQUAL( 0,         get_rex_balance_obj( bob )["rex_maturities"][ring_size - 1]["second"].as<int64_t>() );
+   BOOST_REQUIRE_EQUAL( success(), consolidate( bob ) );
+   rex_balance = get_rex_balance_obj( bob );
+   BOOST_REQUIRE_EQUAL( ring_size, rex_balance["rex_maturities"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( 0,         rex_balance["matured_rex"].as<int64_t>() );
+
+   produce_block( fc::days(6) );
+   BOOST_REQUIRE_EQUAL( success(), sellrex( bob, asset( 3 * rex_bucket.get_amount(), rex_bucket.get_symbol() ) ) );
+   rex_balance = get_rex_balance_obj( bob );
+   BOOST_REQUIRE_EQUAL( 0,         rex_balance["rex_balance"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( ring_size, rex_balance["rex_maturities"].get_array().size() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(rexexec_budget, eosio_system_tester) try {
+   const asset init_balance = core_sym::from_string("100000.0000");
+   const std::vector<account_name> accounts = { "aliceaccount"_n, "bobbyaccount"_n };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("50000.0000") ) );
+
+   const asset fee = core_sym::from_string("1.0000");
+   for ( uint8_t i = 0; i < 4; ++i ) {
+      BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, fee ) );
+   }
+   produce_block( fc::days(31) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("budget must be positive"),
+                        push_action( bob, "rexexec"_n, mvo()("user", bob)("max", 10)("budget", 0) ) );
+
+   // a closed loan costs 2 work units, the loan that exhausts the budget is completed
+   BOOST_REQUIRE_EQUAL( success(), push_action( bob, "rexexec"_n, mvo()("user", bob)("max", 10)("budget", 1) ) );
+   BOOST_REQUIRE( get_cpu_loan( 1 ).is_null() );
+   BOOST_REQUIRE( !get_cpu_loan( 2 ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( bob, "rexexec"_n, mvo()("user", bob)("max", 10)("budget", 4) ) );
+   BOOST_REQUIRE( get_cpu_loan( 3 ).is_null() );
+   BOOST_REQUIRE( !get_cpu_loan( 4 ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( bob, "rexexec"_n, mvo()("user", bob)("max", 10)("budget", 100) ) );
+   BOOST_REQUIRE( get_cpu_loan( 4 ).is_null() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(rex_pool_write_back, eosio_system_tester) try {
+   const asset init_balance = core_sym::from_string("100000.0000");
+   const std::vector<account_name> accounts = { "aliceaccount"_n, "bobbyaccount"_n };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("50000.0000") ) );
+
+   const auto check_pool = [&]( int64_t lent ) {
+      const auto pool = get_rex_pool();
+      BOOST_REQUIRE_EQUAL( lent, pool["total_lent"].as<asset>().get_amount() );
+      BOOST_REQUIRE_EQUAL( pool["total_lendable"].as<asset>().get_amount(),
+                           pool["total_unlent"].as<asset>().get_amount() + pool["total_lent"].as<asset>().get_amount() );
+   };
+
+   // every loan of one action lands in the pool row written back at its end
+   int64_t lent = 0;
+   const asset fee = core_sym::from_string("1.0000");
+   for ( uint64_t i = 1; i <= 4; ++i ) {
+      BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, fee ) );
+      lent += get_cpu_loan( i )["total_staked"].as<asset>().get_amount();
+      check_pool( lent );
+   }
+   BOOST_REQUIRE_EQUAL( 4, get_rex_pool()["loan_num"].as<uint64_t>() );
+
+   // closing all of them in a single rexexec returns all of it
+   produce_block( fc::days(31) );
+   BOOST_REQUIRE_EQUAL( success(), rexexec( bob, 10 ) );
+   for ( uint64_t i = 1; i <= 4; ++i ) {
+      BOOST_REQUIRE( get_cpu_loan( i ).is_null() );
+   }
+   check_pool( 0 );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(rex_keeper, eosio_system_tester) try {
+   const asset init_balance = core_sym::from_string("100000.0000");
+   const std::vector<account_name> accounts = { "aliceaccount"_n, "bobbyaccount"_n, "keeperaccnt1"_n };
+   account_name alice = accounts[0], bob = accounts[1], keeper = accounts[2];
+   setup_rex_accounts( accounts, init_balance );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("rex system not initialized yet"),
+                        push_action( config::system_account_name, "setrexkeep"_n, mvo()("enabled", true) ) );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("50000.0000") ) );
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( alice, "setrexkeep"_n, mvo()("enabled", true) ) );
+   BOOST_REQUIRE( get_rex_config().is_null() );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "setrexkeep"_n, mvo()("enabled", true) ) );
+   BOOST_REQUIRE_EQUAL( true, get_rex_config()["keeper_mode"].as<bool>() );
+
+   const asset fee = core_sym::from_string("1.0000");
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, fee ) );
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, fee ) );
+   produce_block( fc::days(31) );
+
+   // in keeper mode, neither onblock nor REX actions of users process expired loans
+   produce_blocks( 2 );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), rentcpu( bob, bob, fee ) );
+   BOOST_REQUIRE( !get_cpu_loan( 1 ).is_null() );
+   BOOST_REQUIRE( !get_cpu_loan( 2 ).is_null() );
+
+   // rexexec pushed by the keeper does
+   BOOST_REQUIRE_EQUAL( success(), rexexec( keeper, 1 ) );
+   BOOST_REQUIRE( get_cpu_loan( 1 ).is_null() );
+   BOOST_REQUIRE( !get_cpu_loan( 2 ).is_null() );
+
+   // out of keeper mode, REX actions of users process loans again
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "setrexkeep"_n, mvo()("enabled", false) ) );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE( get_cpu_loan( 2 ).is_null() );
+   BOOST_REQUIRE( !get_cpu_loan( 3 ).is_null() );
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file